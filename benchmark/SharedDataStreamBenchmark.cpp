@@ -0,0 +1,406 @@
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "BasicLogger.h"
+#include "CircularBuffer.h"
+#include "SharedDataStream.h"
+
+using namespace Utils::Logger;
+using Utils::DataStructures::CircularBuffer;
+using Utils::DataStructures::OverflowPolicy;
+using Utils::DataStructures::SharedDataStream;
+
+/*
+ * Microbenchmarks of CircularBuffer and SharedDataStream, built for the host
+ * by `make bench`. Every case reports throughput in samples per second and
+ * p50/p99 latency of a single call. Contended cases also report overruns of
+ * readers next to the throughput. Results are written as JSON to the file
+ * given as the first argument, or to stdout.
+ */
+
+using Sample = int16_t;
+using Stream = SharedDataStream<Sample>;
+/// Capacity of the audio input streams, fixed at compile time
+static const size_t FIXED_CAPACITY = 16384;
+using FixedStream = SharedDataStream<Sample, FIXED_CAPACITY>;
+using Clock = std::chrono::steady_clock;
+
+static const size_t CAPACITIES[] = {4096, 16384, 65536};
+static const size_t CHUNKS[] = {64, 256, 1024, 4096};
+static const size_t READER_COUNTS[] = {1, 2, 4, 8, 16};
+/// samples moved through the buffer in every case
+static const size_t SAMPLES_PER_CASE = 1 << 23;
+/// readers of contended cases give up waiting after this
+static const std::chrono::milliseconds READ_TIMEOUT{10};
+
+struct Result {
+    std::string name;
+    std::string policy;
+    size_t capacity;
+    // capacity fixed at compile time
+    bool fixed;
+    size_t chunk;
+    size_t readers;
+    bool contended;
+    size_t calls;
+    double samplesPerSecond;
+    uint64_t p50Ns;
+    uint64_t p99Ns;
+    // of all readers, only counted by contended cases
+    uint64_t overruns;
+    uint64_t lostSamples;
+};
+
+class LatencyRecorder {
+  public:
+    explicit LatencyRecorder(size_t expectedCalls) {
+        m_latencies.reserve(expectedCalls);
+    }
+    void add(Clock::duration latency) {
+        m_latencies.push_back(
+            std::chrono::duration_cast<std::chrono::nanoseconds>(latency)
+                .count());
+    }
+    void merge(const LatencyRecorder& other) {
+        m_latencies.insert(m_latencies.end(), other.m_latencies.begin(),
+                           other.m_latencies.end());
+    }
+    size_t calls() const { return m_latencies.size(); }
+    uint64_t percentile(double p) {
+        if (m_latencies.empty()) {
+            return 0;
+        }
+        size_t index = static_cast<size_t>(p * (m_latencies.size() - 1));
+        std::nth_element(m_latencies.begin(), m_latencies.begin() + index,
+                         m_latencies.end());
+        return m_latencies[index];
+    }
+
+  private:
+    std::vector<uint64_t> m_latencies;
+};
+
+static Result makeResult(const std::string& name,
+                         const std::string& policy,
+                         size_t capacity,
+                         size_t chunk,
+                         size_t readers,
+                         bool contended,
+                         size_t samples,
+                         Clock::duration elapsed,
+                         LatencyRecorder& recorder) {
+    double seconds = std::chrono::duration<double>(elapsed).count();
+    return Result{name,
+                  policy,
+                  capacity,
+                  false,
+                  chunk,
+                  readers,
+                  contended,
+                  recorder.calls(),
+                  seconds > 0 ? samples / seconds : 0,
+                  recorder.percentile(0.50),
+                  recorder.percentile(0.99),
+                  0,
+                  0};
+}
+
+// whether capacity of @c StreamType is fixed at compile time
+template <typename StreamType>
+struct IsFixed;
+template <>
+struct IsFixed<Stream> {
+    static const bool value = false;
+};
+template <>
+struct IsFixed<FixedStream> {
+    static const bool value = true;
+};
+
+static std::string toString(OverflowPolicy policy) {
+    return policy == OverflowPolicy::BLOCK_WRITER ? "block_writer"
+                                                  : "drop_oldest";
+}
+
+static Result benchPushRegion(size_t capacity, size_t chunk) {
+    CircularBuffer<Sample> circularBuffer(capacity);
+    std::vector<Sample> data(chunk, 1);
+    size_t calls = SAMPLES_PER_CASE / chunk;
+    size_t nDeleted = 0;
+    LatencyRecorder recorder(calls);
+
+    auto begin = Clock::now();
+    for (size_t i = 0; i < calls; i++) {
+        auto start = Clock::now();
+        circularBuffer.pushRegion(data.data(), chunk, nDeleted);
+        recorder.add(Clock::now() - start);
+    }
+    auto elapsed = Clock::now() - begin;
+    return makeResult("CircularBuffer::pushRegion", "", capacity, chunk, 0,
+                      false, calls * chunk, elapsed, recorder);
+}
+
+static Result benchGetRegion(size_t capacity, size_t chunk) {
+    CircularBuffer<Sample> circularBuffer(capacity);
+    std::vector<Sample> data(capacity, 1);
+    circularBuffer.pushRegion(data.data(), capacity);
+    // move the wrap point inside the buffer, so some regions are split
+    circularBuffer.pushRegion(data.data(), capacity / 3);
+    size_t calls = SAMPLES_PER_CASE / chunk;
+    size_t nIndex = capacity - chunk + 1;
+    LatencyRecorder recorder(calls);
+
+    auto begin = Clock::now();
+    for (size_t i = 0; i < calls; i++) {
+        size_t index = (i * chunk) % nIndex;
+        auto start = Clock::now();
+        circularBuffer.getRegion(data.data(), index, chunk);
+        recorder.add(Clock::now() - start);
+    }
+    auto elapsed = Clock::now() - begin;
+    return makeResult("CircularBuffer::getRegion", "", capacity, chunk, 0,
+                      false, calls * chunk, elapsed, recorder);
+}
+
+template <typename StreamType>
+static Result benchWrite(size_t capacity, size_t chunk, size_t nReaders) {
+    StreamType stream(capacity);
+    auto writer = stream.createWriter();
+    // idle readers, drop oldest writer should not care about them
+    std::vector<std::shared_ptr<typename StreamType::Reader>> readers;
+    for (size_t i = 0; i < nReaders; i++) {
+        readers.push_back(stream.createReader());
+    }
+    std::vector<Sample> data(chunk, 1);
+    size_t calls = SAMPLES_PER_CASE / chunk;
+    LatencyRecorder recorder(calls);
+
+    auto begin = Clock::now();
+    for (size_t i = 0; i < calls; i++) {
+        auto start = Clock::now();
+        writer->write(data.data(), chunk);
+        recorder.add(Clock::now() - start);
+    }
+    auto elapsed = Clock::now() - begin;
+    Result result = makeResult(
+        "Writer::write", toString(OverflowPolicy::DROP_OLDEST), capacity, chunk,
+        nReaders, false, calls * chunk, elapsed, recorder);
+    result.fixed = IsFixed<StreamType>::value;
+    return result;
+}
+
+template <typename StreamType>
+static Result benchRead(size_t capacity, size_t chunk) {
+    StreamType stream(capacity);
+    auto writer = stream.createWriter();
+    auto reader = stream.createReader();
+    std::vector<Sample> data(capacity, 1);
+    size_t calls = SAMPLES_PER_CASE / chunk;
+    LatencyRecorder recorder(calls);
+
+    Clock::duration elapsed{0};
+    size_t nRead = 0;
+    while (nRead < calls) {
+        // refill is not measured
+        writer->write(data.data(), capacity);
+        auto begin = Clock::now();
+        while (nRead < calls && reader->getAvailableNum() >= chunk) {
+            auto start = Clock::now();
+            reader->read(data.data(), chunk);
+            recorder.add(Clock::now() - start);
+            nRead++;
+        }
+        elapsed += Clock::now() - begin;
+    }
+    Result result =
+        makeResult("Reader::read", toString(OverflowPolicy::DROP_OLDEST),
+                   capacity, chunk, 1, false, calls * chunk, elapsed, recorder);
+    result.fixed = IsFixed<StreamType>::value;
+    return result;
+}
+
+/*
+ * One writer thread and @c nReaders reader threads run at the same time.
+ * Reports latency of Writer::write and Reader::read of all readers, and how
+ * often readers were overrun next to the throughput.
+ */
+template <typename StreamType>
+static void benchContended(size_t capacity,
+                           size_t chunk,
+                           size_t nReaders,
+                           OverflowPolicy policy,
+                           std::vector<Result>& results) {
+    StreamType stream(capacity,
+                      Utils::DataStructures::CircularBufferStorage::HEAP,
+                      policy);
+    auto writer = stream.createWriter();
+    std::vector<std::shared_ptr<typename StreamType::Reader>> readers;
+    for (size_t i = 0; i < nReaders; i++) {
+        readers.push_back(stream.createReader());
+    }
+    size_t calls = SAMPLES_PER_CASE / chunk / 4;
+    std::atomic<bool> isWriting{true};
+    std::vector<LatencyRecorder> readRecorders(nReaders,
+                                               LatencyRecorder(calls));
+    std::vector<size_t> readSamples(nReaders, 0);
+
+    std::vector<std::thread> readerThreads;
+    for (size_t i = 0; i < nReaders; i++) {
+        readerThreads.emplace_back([&, i]() {
+            std::vector<Sample> buf(chunk);
+            auto& reader = readers[i];
+            while (true) {
+                size_t available = reader->wait(1, READ_TIMEOUT);
+                if (available == 0) {
+                    if (!isWriting) {
+                        break;
+                    }
+                    continue;
+                }
+                size_t num = available < chunk ? available : chunk;
+                auto start = Clock::now();
+                readSamples[i] += reader->read(buf.data(), num);
+                readRecorders[i].add(Clock::now() - start);
+            }
+        });
+    }
+
+    std::vector<Sample> data(chunk, 1);
+    LatencyRecorder writeRecorder(calls);
+    // a DROP_OLDEST writer which isn't paced laps its readers, which then
+    // mostly skip overrun data. Keep them within half of the stream, like an
+    // audio device would, so they read what is written
+    const uint64_t maxLag = capacity / 2;
+    auto begin = Clock::now();
+    for (size_t i = 0; i < calls; i++) {
+        if (policy == OverflowPolicy::DROP_OLDEST) {
+            uint64_t writePosition = static_cast<uint64_t>(i) * chunk;
+            for (auto& reader : readers) {
+                while (writePosition > reader->getPosition() + maxLag) {
+                    std::this_thread::yield();
+                }
+            }
+        }
+        auto start = Clock::now();
+        writer->write(data.data(), chunk);
+        writeRecorder.add(Clock::now() - start);
+    }
+    auto writeElapsed = Clock::now() - begin;
+    isWriting = false;
+    for (auto& thread : readerThreads) {
+        thread.join();
+    }
+    auto readElapsed = Clock::now() - begin;
+
+    // latencies of all readers together
+    LatencyRecorder readRecorder(0);
+    size_t totalReadSamples = 0;
+    uint64_t overruns = 0;
+    uint64_t lostSamples = 0;
+    for (size_t i = 0; i < nReaders; i++) {
+        readRecorder.merge(readRecorders[i]);
+        totalReadSamples += readSamples[i];
+        overruns += readers[i]->getOverrunCount();
+        lostSamples += readers[i]->getOverrunNum();
+    }
+    Result writeResult = makeResult("Writer::write", toString(policy),
+                                    capacity, chunk, nReaders, true,
+                                    calls * chunk, writeElapsed, writeRecorder);
+    Result readResult =
+        makeResult("Reader::read", toString(policy), capacity, chunk, nReaders,
+                   true, totalReadSamples, readElapsed, readRecorder);
+    for (Result* result : {&writeResult, &readResult}) {
+        result->fixed = IsFixed<StreamType>::value;
+        result->overruns = overruns;
+        result->lostSamples = lostSamples;
+    }
+    results.push_back(writeResult);
+    results.push_back(readResult);
+}
+
+static void printJson(const std::vector<Result>& results, std::ostream& out) {
+    std::ostringstream json;
+    json << "{\n  \"benchmarks\": [\n";
+    for (size_t i = 0; i < results.size(); i++) {
+        const Result& r = results[i];
+        json << "    {\"name\": \"" << r.name << "\", \"policy\": \""
+             << r.policy << "\", \"capacity\": " << r.capacity
+             << ", \"fixed\": " << (r.fixed ? "true" : "false")
+             << ", \"chunk\": " << r.chunk << ", \"readers\": " << r.readers
+             << ", \"contended\": " << (r.contended ? "true" : "false")
+             << ", \"calls\": " << r.calls
+             << ", \"samples_per_second\": " << static_cast<uint64_t>(
+                                                    r.samplesPerSecond)
+             << ", \"p50_ns\": " << r.p50Ns << ", \"p99_ns\": " << r.p99Ns
+             << ", \"overruns\": " << r.overruns
+             << ", \"lost_samples\": " << r.lostSamples
+             << "}" << (i + 1 < results.size() ? "," : "") << "\n";
+    }
+    json << "  ]\n}\n";
+    out << json.str();
+}
+
+int main(int argc, char const* argv[]) {
+    // overrun warnings of contended cases would flood the result
+    BasicLogger::getInstance().setLogFilterLvl(LogLevel::ERROR);
+
+    std::vector<Result> results;
+    for (size_t capacity : CAPACITIES) {
+        for (size_t chunk : CHUNKS) {
+            if (chunk > capacity) {
+                continue;
+            }
+            results.push_back(benchPushRegion(capacity, chunk));
+            results.push_back(benchGetRegion(capacity, chunk));
+            results.push_back(benchRead<Stream>(capacity, chunk));
+            for (size_t nReaders : READER_COUNTS) {
+                results.push_back(
+                    benchWrite<Stream>(capacity, chunk, nReaders));
+            }
+        }
+    }
+    // same size with capacity fixed at compile time, wrapped by mask
+    for (size_t chunk : CHUNKS) {
+        results.push_back(benchRead<FixedStream>(FIXED_CAPACITY, chunk));
+        for (size_t nReaders : READER_COUNTS) {
+            results.push_back(
+                benchWrite<FixedStream>(FIXED_CAPACITY, chunk, nReaders));
+        }
+    }
+
+    // contended cases only on the size used by the audio input stream
+    for (size_t chunk : CHUNKS) {
+        for (size_t nReaders : READER_COUNTS) {
+            for (OverflowPolicy policy :
+                 {OverflowPolicy::DROP_OLDEST, OverflowPolicy::BLOCK_WRITER}) {
+                benchContended<Stream>(FIXED_CAPACITY, chunk, nReaders, policy,
+                                       results);
+                benchContended<FixedStream>(FIXED_CAPACITY, chunk, nReaders,
+                                            policy, results);
+            }
+        }
+    }
+
+    if (argc > 1) {
+        std::ofstream resultFile(argv[1]);
+        if (!resultFile) {
+            BasicLogger::getInstance().log(
+                "Benchmark", LogLevel::ERROR,
+                std::string("Failed to open ") + argv[1]);
+            return 1;
+        }
+        printJson(results, resultFile);
+    } else {
+        printJson(results, std::cout);
+    }
+    return 0;
+}
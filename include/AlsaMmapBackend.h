@@ -0,0 +1,73 @@
+#pragma once
+
+#include <alsa/asoundlib.h>
+
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+
+#include "AudioBackend.h"
+
+namespace Audio {
+namespace Alsa {
+/**
+ * @brief Backend which drives ALSA devices directly through the mmap API.
+ * Callbacks get a pointer straight into the device ring buffer between
+ * @c snd_pcm_mmap_begin and @c snd_pcm_mmap_commit, so captured periods are
+ * copied once into the stream and played samples are read once from it,
+ * without PortAudio's extra buffering stage. Each stream runs on its own
+ * thread, with SCHED_FIFO if the process is allowed to.
+ *
+ * Only interleaved samples, INPUT and OUTPUT are supported.
+ */
+class AlsaMmapBackend final : public AudioBackend {
+  public:
+    /**
+     * @brief Construct a new Alsa Mmap Backend object. Devices are opened by
+     * @c addStream
+     *
+     * @param captureDevice ALSA pcm name for INPUT, e.g. "plughw:1,0"
+     * @param playbackDevice ALSA pcm name for OUTPUT
+     */
+    AlsaMmapBackend(const std::string& captureDevice = "default",
+                    const std::string& playbackDevice = "default");
+    ~AlsaMmapBackend();
+
+    void addStream(const AudioBackendConfig& config) override;
+    void startStream(const IOType& type) override;
+    void stopStream(const IOType& type) override;
+
+  private:
+    struct Stream {
+        snd_pcm_t* pcm = nullptr;
+        AudioBackendConfig config;
+        snd_pcm_uframes_t periodSize = 0;
+        std::atomic<bool> isRunning{false};
+        std::unique_ptr<std::thread> thread;
+    };
+
+    // noncopyable
+    AlsaMmapBackend(const AlsaMmapBackend&) = delete;
+    AlsaMmapBackend& operator=(const AlsaMmapBackend&) = delete;
+
+    void openStream(Stream& stream,
+                    const std::string& device,
+                    const AudioBackendConfig& config);
+    void closeStream(Stream& stream);
+    // run on stream thread until stopped
+    void captureLoop(Stream& stream);
+    void playbackLoop(Stream& stream);
+    // stream of @c type, nullptr if type is invalid
+    Stream* getStream(const IOType& type);
+
+    const std::string m_captureDevice;
+    const std::string m_playbackDevice;
+    Stream m_captureStream;
+    Stream m_playbackStream;
+
+    std::mutex m_alsaMtx;
+};
+}  // namespace Alsa
+}  // namespace Audio
@@ -0,0 +1,107 @@
+#pragma once
+
+#include <cstddef>
+
+namespace Audio {
+enum class IOType {
+    INPUT = 0,  // Backend will have input capture
+    OUTPUT,     // Backend will have output
+    DUPLEX      // One stream with both input and output, on the same clock
+};
+
+/**
+ * Native sample formats of devices, all interleaved and host endian
+ */
+enum class SampleFormat {
+    INT16 = 0,
+    INT24,  // packed in 3 bytes
+    INT32,
+    FLOAT32  // full scale is [-1, 1]
+};
+
+/// Bytes of one sample of @c format
+inline size_t getSampleSize(SampleFormat format) {
+    switch (format) {
+        case SampleFormat::INT16:
+            return 2;
+        case SampleFormat::INT24:
+            return 3;
+        default:
+            return 4;
+    }
+}
+
+/// Significant bits of one sample of @c format
+inline int getBitsPerSample(SampleFormat format) {
+    return format == SampleFormat::FLOAT32 ? 32 : getSampleSize(format) * 8;
+}
+
+/**
+ * Status flags passed to backend callbacks, same values as PortAudio's
+ * PaStreamCallbackFlags
+ */
+static constexpr unsigned long AUDIO_INPUT_UNDERFLOW = 0x00000001;
+static constexpr unsigned long AUDIO_INPUT_OVERFLOW = 0x00000002;
+static constexpr unsigned long AUDIO_OUTPUT_UNDERFLOW = 0x00000004;
+static constexpr unsigned long AUDIO_OUTPUT_OVERFLOW = 0x00000008;
+
+/**
+ * @brief Sound device which calls back with captured samples and for samples
+ * to play. Callbacks are called on a real-time thread owned by the backend,
+ * they must not allocate, lock, log or make syscalls.
+ *
+ */
+class AudioBackend {
+  public:
+    /**
+     * @brief Called with @c numSamples captured frames.
+     *
+     * @param statusFlags e.g. AUDIO_INPUT_OVERFLOW
+     */
+    using InputCallback = void (*)(const void* data,
+                                   unsigned long numSamples,
+                                   unsigned long statusFlags,
+                                   void* userData);
+    /**
+     * @brief Called to fill the device buffer with @c numSamples frames.
+     *
+     * @param statusFlags e.g. AUDIO_OUTPUT_UNDERFLOW
+     */
+    using OutputCallback = void (*)(void* data,
+                                    unsigned long numSamples,
+                                    unsigned long statusFlags,
+                                    void* userData);
+
+    struct AudioBackendConfig {
+        int sampleRate;
+        int numChannels;
+        // must agree with sampleFormat
+        int bitsPerSample;
+        // INPUT or OUTPUT
+        IOType type;
+        SampleFormat sampleFormat = SampleFormat::INT16;
+        InputCallback inputCallback = nullptr;
+        OutputCallback outputCallback = nullptr;
+        // passed to callbacks as it is
+        void* userData = nullptr;
+        // frames per callback, 0 lets the backend choose
+        unsigned long framesPerBuffer = 0;
+    };
+
+    virtual ~AudioBackend() = default;
+
+    /**
+     * @brief add stream with @c specific config. Throws @c BaseException if
+     * failed.
+     */
+    virtual void addStream(const AudioBackendConfig& config) = 0;
+    virtual void startStream(const IOType& type) = 0;
+    virtual void stopStream(const IOType& type) = 0;
+    /**
+     * @brief Whether callbacks are driven by a device clock. If not, e.g.
+     * when playing a file, callbacks may block until consumers take the
+     * samples, instead of dropping them.
+     */
+    virtual bool isRealTime() const { return true; }
+};
+}  // namespace Audio
@@ -5,8 +5,17 @@
 namespace Audio {
 using AudioInputStreamSize = int16_t;
 using AudioOutputStreamSize = int16_t;
+static constexpr size_t AudioInputStreamCapacity = 16384;
+// capacity decided at run time, so detectors and assistant can peek frames
+// out of CircularBufferStorage::MIRRORED storage without a wrap point
 using AudioInputStream =
     Utils::DataStructures::SharedDataStream<AudioInputStreamSize>;
+// float samples in 16 bits range, for consumers which take float directly.
+// Power of two, so the stream wraps by mask and stores data inline
+using AudioInputFloatStreamSize = float;
+using AudioInputFloatStream =
+    Utils::DataStructures::SharedDataStream<AudioInputFloatStreamSize,
+                                            AudioInputStreamCapacity>;
 using AudioOutputStream =
     Utils::DataStructures::SharedDataStream<AudioOutputStreamSize>;
 }  // namespace Audio
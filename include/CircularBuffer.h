@@ -1,43 +1,181 @@
 #pragma once
 
+#include <array>
 #include <cstddef>
+#include <cstdint>
 #include <cstring>
+#include <iterator>
+#include <memory>
+#include <stdexcept>
+#include <type_traits>
 #include <vector>
 
+#include "MirroredMemory.h"
+
 namespace Utils {
 namespace DataStructures {
+enum class CircularBufferStorage {
+    HEAP = 0,  // plain heap memory
+    MIRRORED   // pages mapped twice back-to-back, see MirroredMemory
+};
+
+/**
+ * Storage of CircularBuffer with capacity @c N known at compile time. @c N must
+ * be a power of two, so mapping an index to a slot is a mask, and elements are
+ * stored inline without heap indirection.
+ */
+template <typename T, size_t N>
+class CircularBufferMemory {
+    static_assert(N > 0 && (N & (N - 1)) == 0,
+                  "Capacity of CircularBuffer must be a power of two");
+
+  protected:
+    CircularBufferMemory(size_t size, CircularBufferStorage storage)
+        : m_array{} {
+        if (storage != CircularBufferStorage::HEAP) {
+            throw std::invalid_argument(
+                "CircularBuffer: inline storage can't be mirrored");
+        }
+        allocate(size);
+    }
+
+    static constexpr size_t capacity() { return N; }
+    template <typename Index>
+    static constexpr size_t wrap(Index index) {
+        return static_cast<size_t>(index & (N - 1));
+    }
+    T* data() { return m_array.data(); }
+    const T* data() const { return m_array.data(); }
+    static constexpr bool isMirrored() { return false; }
+    void allocate(size_t size) {
+        if (size != N) {
+            throw std::invalid_argument(
+                "CircularBuffer: capacity is fixed at compile time");
+        }
+    }
+
+  private:
+    std::array<T, N> m_array;
+};
+
+/**
+ * Storage of CircularBuffer with capacity decided at run time, on heap or in
+ * mirrored memory.
+ */
 template <typename T>
-class CircularBuffer {
-    // CircularBuffer container based on std::vector. Iterator is implemented
+class CircularBufferMemory<T, 0> {
+  protected:
+    CircularBufferMemory(size_t size, CircularBufferStorage storage)
+        : m_bufferSize{0}, m_storage{storage}, m_data{nullptr} {
+        allocate(size);
+    }
+
+    size_t capacity() const { return m_bufferSize; }
+    template <typename Index>
+    size_t wrap(Index index) const {
+        return static_cast<size_t>(index % m_bufferSize);
+    }
+    T* data() { return m_data; }
+    const T* data() const { return m_data; }
+    bool isMirrored() const { return m_mirroredMemory != nullptr; }
+    // allocate storage for @c size elements, update m_bufferSize and m_data
+    void allocate(size_t size);
+
+  private:
+    size_t m_bufferSize;
+    const CircularBufferStorage m_storage;
+    std::vector<T> m_buffer;  // storage for CircularBufferStorage::HEAP
+    std::unique_ptr<MirroredMemory>
+        m_mirroredMemory;  // storage for CircularBufferStorage::MIRRORED
+    T* m_data;
+};
+
+template <typename T>
+void CircularBufferMemory<T, 0>::allocate(size_t size) {
+    if (m_storage == CircularBufferStorage::MIRRORED && size > 0) {
+        size_t pageSize = MirroredMemory::pageSize();
+        if (pageSize % sizeof(T) != 0) {
+            throw std::invalid_argument(
+                "CircularBuffer: element size doesn't fit page size");
+        }
+        // round up to whole pages
+        size_t nBytes = (size * sizeof(T) + pageSize - 1) / pageSize * pageSize;
+        m_mirroredMemory.reset(new MirroredMemory(nBytes));
+        m_data = static_cast<T*>(m_mirroredMemory->data());
+        m_bufferSize = nBytes / sizeof(T);
+    } else {
+        m_mirroredMemory.reset();
+        m_buffer.assign(size, T());
+        m_data = m_buffer.data();
+        m_bufferSize = size;
+    }
+}
+
+template <typename T, size_t N = 0>
+class CircularBuffer : private CircularBufferMemory<T, N> {
+    // CircularBuffer container based on a fixed capacity ring with head/tail
+    // index. Once the buffer is full, new elements overwrite the oldest ones.
+    // Every element pushed back also gets an absolute position which never
+    // wraps, position p is always stored in slot p % capacity().
+    // With CircularBufferStorage::MIRRORED, capacity is rounded up to a
+    // multiple of page size and every region, even the one crossing the wrap
+    // point, is continuous in memory.
+    // If @c N is not 0, capacity is fixed at compile time, see
+    // CircularBufferMemory.
+    // Iterator is implemented
     // Thread safe should be guaranteed by caller
+    static_assert(std::is_trivially_copyable<T>::value,
+                  "CircularBuffer copies elements by memcpy");
+
   public:
-    CircularBuffer(size_t size);
+    template <bool IsConst>
+    class Iterator;
+    using iterator = Iterator<false>;
+    using const_iterator = Iterator<true>;
+    using reverse_iterator = std::reverse_iterator<iterator>;
+    using const_reverse_iterator = std::reverse_iterator<const_iterator>;
+
+    CircularBuffer(size_t size,
+                   CircularBufferStorage storage = CircularBufferStorage::HEAP);
     ~CircularBuffer();
 
     // override []
     T& operator[](size_t i);
+    const T& operator[](size_t i) const;
     T at(size_t i);
     void push_back(T element);
     void push_front(T element);
     const T& back() const;
     const T& front() const;
-    typename std::vector<T>::iterator begin();
-    typename std::vector<T>::iterator end();
-    typename std::vector<T>::const_iterator begin() const;
-    typename std::vector<T>::const_iterator end() const;
-    typename std::vector<T>::reverse_iterator rbegin();
-    typename std::vector<T>::reverse_iterator rend();
-    typename std::vector<T>::const_reverse_iterator rbegin() const;
-    typename std::vector<T>::const_reverse_iterator rend() const;
+    iterator begin();
+    iterator end();
+    const_iterator begin() const;
+    const_iterator end() const;
+    reverse_iterator rbegin();
+    reverse_iterator rend();
+    const_reverse_iterator rbegin() const;
+    const_reverse_iterator rend() const;
     bool full() const;
     bool empty() const;
     void clear();
+    /*
+     * Change the capacity of circular buffer. If @c newSize is smaller than
+     * the current num of elements, the oldest elements will be deleted.
+     * Capacity of a fixed size buffer can't change, only @c N is accepted.
+     */
     void resize(size_t newSize);
-    typename std::vector<T>::size_type size() const;
+    size_t size() const;
+    size_t capacity() const;
+    /*
+     * Absolute position of the oldest element, and position one past the
+     * newest element. Positions are assigned by push_back and pushRegion
+     */
+    uint64_t beginPosition() const;
+    uint64_t endPosition() const;
     /*
      * This function provide a more efficient way to push a continuous elements
-     * region to the end of circular buffer(using memcpy instead of push_back
-     * one by one)
+     * region to the end of circular buffer(using at most two memcpy instead of
+     * push_back one by one)
      * @para elementsAddr start addr of elements need to push
      * @para nWrite num of elements need to push
      * @return the num of elements pushed success. return 0 if push failed
@@ -54,177 +192,420 @@ class CircularBuffer {
     size_t pushRegion(const T* elementsAddr, size_t nWrite, size_t& nDeleted);
     /*
      * This function provide a more efficient way to read a continuous elements
-     * region from the specific region of circular buffer(using memcpy instead
-     * of read one by one)
+     * region from the specific region of circular buffer(using at most two
+     * memcpy instead of read one by one)
      * @para elementsAddr destination addr of elements to store read region
-     * @para index the index start to read
+     * @para index the index start to read, 0 is the oldest element
      * @para nRead the num of elements need to be read. if nRead is 0, will try
      * to read everything can be read
      * @return the num of elements read success. return 0 if read failed
      */
     size_t getRegion(T* elementsAddr, size_t index, size_t nRead);
+    /*
+     * Read a continuous elements region starting from an absolute position,
+     * without looking at head/tail. This is used by lock-free readers which
+     * track their own position and validate the data by themselves
+     * @para elementsAddr destination addr of elements to store read region
+     * @para position the absolute position start to read
+     * @para nRead the num of elements need to be read, must be <= capacity()
+     * @return the num of elements read success. return 0 if read failed
+     */
+    size_t getRegionAt(T* elementsAddr, uint64_t position, size_t nRead) const;
+    /*
+     * Get pointers to a region starting from an absolute position without
+     * copying anything. Because of the wrap point, the region may be split
+     * into two parts, @c size2 is 0 if the region is continuous
+     * @para position the absolute position of region
+     * @para nRead the num of elements in region, must be <= capacity()
+     */
+    void getRegionPointersAt(uint64_t position,
+                             size_t nRead,
+                             const T*& data1,
+                             size_t& size1,
+                             const T*& data2,
+                             size_t& size2) const;
 
   private:
-    size_t m_bufferSize;
-    std::vector<T> m_buffer;
+    using Memory = CircularBufferMemory<T, N>;
+    using Memory::allocate;
+    using Memory::data;
+    using Memory::isMirrored;
+    using Memory::wrap;
+
+    // map a logical index (0 is the oldest element) to a slot in storage
+    size_t slot(size_t index) const;
+    // copy @c n elements from/to ring starting at @c startSlot, handle the
+    // wrap point with a second memcpy
+    void copyIn(size_t startSlot, const T* src, size_t n);
+    void copyOut(T* dst, size_t startSlot, size_t n) const;
+
+    size_t m_head;  // slot of the oldest element
+    size_t m_tail;  // slot for the next element to push back
+    size_t m_size;
+    uint64_t m_endPosition;  // position of the next element to push back
 };
 
-template <class T>
-CircularBuffer<T>::CircularBuffer(size_t bufferSize)
-    : m_bufferSize(bufferSize) {}
+template <typename T, size_t N>
+template <bool IsConst>
+class CircularBuffer<T, N>::Iterator {
+    // Random access iterator over logical index of CircularBuffer
+  public:
+    using iterator_category = std::random_access_iterator_tag;
+    using value_type = T;
+    using difference_type = std::ptrdiff_t;
+    using pointer = typename std::conditional<IsConst, const T*, T*>::type;
+    using reference = typename std::conditional<IsConst, const T&, T&>::type;
+    using container_type =
+        typename std::conditional<IsConst,
+                                  const CircularBuffer<T, N>,
+                                  CircularBuffer<T, N>>::type;
 
-template <class T>
-CircularBuffer<T>::~CircularBuffer() {}
+    Iterator(container_type* buffer, size_t index)
+        : m_container{buffer}, m_index{index} {}
+    // allow iterator to const_iterator conversion
+    operator Iterator<true>() const { return {m_container, m_index}; }
 
-template <typename T>
-T& CircularBuffer<T>::operator[](size_t i) {
-    return m_buffer[i];
+    reference operator*() const { return (*m_container)[m_index]; }
+    pointer operator->() const { return &(*m_container)[m_index]; }
+    reference operator[](difference_type n) const {
+        return (*m_container)[m_index + n];
+    }
+    Iterator& operator++() {
+        ++m_index;
+        return *this;
+    }
+    Iterator operator++(int) {
+        Iterator tmp = *this;
+        ++m_index;
+        return tmp;
+    }
+    Iterator& operator--() {
+        --m_index;
+        return *this;
+    }
+    Iterator operator--(int) {
+        Iterator tmp = *this;
+        --m_index;
+        return tmp;
+    }
+    Iterator& operator+=(difference_type n) {
+        m_index += n;
+        return *this;
+    }
+    Iterator& operator-=(difference_type n) {
+        m_index -= n;
+        return *this;
+    }
+    Iterator operator+(difference_type n) const {
+        return {m_container, m_index + n};
+    }
+    Iterator operator-(difference_type n) const {
+        return {m_container, m_index - n};
+    }
+    difference_type operator-(const Iterator& other) const {
+        return static_cast<difference_type>(m_index) -
+               static_cast<difference_type>(other.m_index);
+    }
+    bool operator==(const Iterator& other) const {
+        return m_index == other.m_index;
+    }
+    bool operator!=(const Iterator& other) const {
+        return m_index != other.m_index;
+    }
+    bool operator<(const Iterator& other) const {
+        return m_index < other.m_index;
+    }
+    bool operator>(const Iterator& other) const {
+        return m_index > other.m_index;
+    }
+    bool operator<=(const Iterator& other) const {
+        return m_index <= other.m_index;
+    }
+    bool operator>=(const Iterator& other) const {
+        return m_index >= other.m_index;
+    }
+
+  private:
+    container_type* m_container;
+    size_t m_index;
+};
+
+template <typename T, size_t N>
+CircularBuffer<T, N>::CircularBuffer(size_t bufferSize,
+                                  CircularBufferStorage storage)
+    : Memory(bufferSize, storage),
+      m_head(0),
+      m_tail(0),
+      m_size(0),
+      m_endPosition(0) {}
+
+template <typename T, size_t N>
+CircularBuffer<T, N>::~CircularBuffer() {}
+
+template <typename T, size_t N>
+T& CircularBuffer<T, N>::operator[](size_t i) {
+    return data()[slot(i)];
 }
-template <class T>
-void CircularBuffer<T>::push_back(T element) {
-    m_buffer.push_back(element);
-    if (m_buffer.size() > m_bufferSize) m_buffer.erase(begin());
+
+template <typename T, size_t N>
+const T& CircularBuffer<T, N>::operator[](size_t i) const {
+    return data()[slot(i)];
 }
 
-template <class T>
-void CircularBuffer<T>::push_front(T element) {
-    m_buffer.insert(m_buffer.begin(), element);
-    if (m_buffer.size() > m_bufferSize) m_buffer.pop_back();
+template <typename T, size_t N>
+T CircularBuffer<T, N>::at(size_t i) {
+    if (i >= m_size) {
+        throw std::out_of_range("CircularBuffer::at: index out of range");
+    }
+    return data()[slot(i)];
 }
-template <class T>
-const T& CircularBuffer<T>::back() const {
-    return m_buffer.back();
+
+template <typename T, size_t N>
+void CircularBuffer<T, N>::push_back(T element) {
+    if (capacity() == 0) return;
+    data()[m_tail] = element;
+    m_tail = wrap(m_tail + 1);
+    m_endPosition++;
+    if (m_size == capacity()) {
+        // overwrite the oldest element
+        m_head = m_tail;
+    } else {
+        m_size++;
+    }
 }
 
-template <class T>
-const T& CircularBuffer<T>::front() const {
-    return m_buffer.front();
+template <typename T, size_t N>
+void CircularBuffer<T, N>::push_front(T element) {
+    if (capacity() == 0) return;
+    m_head = wrap(m_head + capacity() - 1);
+    data()[m_head] = element;
+    if (m_size == capacity()) {
+        // drop the newest element
+        m_tail = m_head;
+        m_endPosition--;
+    } else {
+        m_size++;
+    }
 }
 
-template <class T>
-typename std::vector<T>::iterator CircularBuffer<T>::begin() {
-    return m_buffer.begin();
+template <typename T, size_t N>
+const T& CircularBuffer<T, N>::back() const {
+    return data()[slot(m_size - 1)];
 }
 
-template <class T>
-typename std::vector<T>::iterator CircularBuffer<T>::end() {
-    return m_buffer.end();
+template <typename T, size_t N>
+const T& CircularBuffer<T, N>::front() const {
+    return data()[m_head];
 }
 
-template <class T>
-typename std::vector<T>::reverse_iterator CircularBuffer<T>::rbegin() {
-    return m_buffer.rbegin();
+template <typename T, size_t N>
+typename CircularBuffer<T, N>::iterator CircularBuffer<T, N>::begin() {
+    return iterator(this, 0);
 }
 
-template <class T>
-typename std::vector<T>::reverse_iterator CircularBuffer<T>::rend() {
-    return m_buffer.rend();
+template <typename T, size_t N>
+typename CircularBuffer<T, N>::iterator CircularBuffer<T, N>::end() {
+    return iterator(this, m_size);
 }
 
-template <class T>
-typename std::vector<T>::const_iterator CircularBuffer<T>::begin() const {
-    return m_buffer.begin();
+template <typename T, size_t N>
+typename CircularBuffer<T, N>::reverse_iterator CircularBuffer<T, N>::rbegin() {
+    return reverse_iterator(end());
 }
 
-template <class T>
-typename std::vector<T>::const_iterator CircularBuffer<T>::end() const {
-    return m_buffer.end();
+template <typename T, size_t N>
+typename CircularBuffer<T, N>::reverse_iterator CircularBuffer<T, N>::rend() {
+    return reverse_iterator(begin());
 }
 
-template <class T>
-typename std::vector<T>::const_reverse_iterator CircularBuffer<T>::rbegin()
+template <typename T, size_t N>
+typename CircularBuffer<T, N>::const_iterator CircularBuffer<T, N>::begin()
     const {
-    return m_buffer.rbegin();
+    return const_iterator(this, 0);
 }
 
-template <class T>
-typename std::vector<T>::const_reverse_iterator CircularBuffer<T>::rend()
+template <typename T, size_t N>
+typename CircularBuffer<T, N>::const_iterator CircularBuffer<T, N>::end()
     const {
-    return m_buffer.rend();
+    return const_iterator(this, m_size);
 }
 
-template <class T>
-bool CircularBuffer<T>::full() const {
-    return m_buffer.size() == m_bufferSize;
+template <typename T, size_t N>
+typename CircularBuffer<T, N>::const_reverse_iterator
+CircularBuffer<T, N>::rbegin() const {
+    return const_reverse_iterator(end());
 }
 
-template <class T>
-bool CircularBuffer<T>::empty() const {
-    return m_buffer.empty();
+template <typename T, size_t N>
+typename CircularBuffer<T, N>::const_reverse_iterator
+CircularBuffer<T, N>::rend() const {
+    return const_reverse_iterator(begin());
 }
 
-template <class T>
-void CircularBuffer<T>::clear() {
-    m_buffer.clear();
+template <typename T, size_t N>
+bool CircularBuffer<T, N>::full() const {
+    return m_size == capacity();
 }
 
-template <class T>
-void CircularBuffer<T>::resize(size_t newSize) {
-    if (newSize >= m_bufferSize)
-        m_bufferSize = newSize;
-    else {
-        for (size_t i = 0; i < m_bufferSize - newSize; i++) {
-            m_buffer.erase(begin());
-        }
-    }
+template <typename T, size_t N>
+bool CircularBuffer<T, N>::empty() const {
+    return m_size == 0;
 }
 
-template <class T>
-typename std::vector<T>::size_type CircularBuffer<T>::size() const {
-    return m_buffer.size();
+template <typename T, size_t N>
+void CircularBuffer<T, N>::clear() {
+    m_tail = (capacity() == 0) ? 0 : wrap(m_endPosition);
+    m_head = m_tail;
+    m_size = 0;
 }
 
-template <class T>
-size_t CircularBuffer<T>::pushRegion(const T* elementsAddr, size_t nWrite) {
-    if (nWrite > m_bufferSize) {
-        return 0;
+template <typename T, size_t N>
+void CircularBuffer<T, N>::resize(size_t newSize) {
+    // keep the newest elements, and store them in the slots matching their
+    // positions in the new storage
+    size_t nKeep = m_size > newSize ? newSize : m_size;
+    std::vector<T> keptElements(nKeep);
+    if (nKeep > 0) {
+        copyOut(keptElements.data(), slot(m_size - nKeep), nKeep);
     }
-    size_t lastIndex = m_buffer.size() - 1;
-    m_buffer.resize(nWrite + m_buffer.size());
-    std::memcpy(&m_buffer[lastIndex + 1], elementsAddr, nWrite * sizeof(T));
-    if ((lastIndex + nWrite) >= m_bufferSize) {
-        // need to delete elements ahead buffer
-        m_buffer.erase(
-            m_buffer.begin(),
-            m_buffer.begin() + ((lastIndex + nWrite) - m_bufferSize + 1));
+    allocate(newSize);
+    newSize = capacity();
+    m_size = nKeep;
+    m_tail = (newSize == 0) ? 0 : wrap(m_endPosition);
+    m_head = (newSize == 0) ? 0 : wrap(m_endPosition - nKeep);
+    if (nKeep > 0) {
+        copyIn(m_head, keptElements.data(), nKeep);
     }
-    return nWrite;
 }
 
-template <class T>
-size_t CircularBuffer<T>::pushRegion(const T* elementsAddr,
+template <typename T, size_t N>
+size_t CircularBuffer<T, N>::size() const {
+    return m_size;
+}
+
+template <typename T, size_t N>
+size_t CircularBuffer<T, N>::capacity() const {
+    return Memory::capacity();
+}
+
+template <typename T, size_t N>
+uint64_t CircularBuffer<T, N>::beginPosition() const {
+    return m_endPosition - m_size;
+}
+
+template <typename T, size_t N>
+uint64_t CircularBuffer<T, N>::endPosition() const {
+    return m_endPosition;
+}
+
+template <typename T, size_t N>
+size_t CircularBuffer<T, N>::pushRegion(const T* elementsAddr, size_t nWrite) {
+    size_t nDeleted;
+    return pushRegion(elementsAddr, nWrite, nDeleted);
+}
+
+template <typename T, size_t N>
+size_t CircularBuffer<T, N>::pushRegion(const T* elementsAddr,
                                      size_t nWrite,
                                      size_t& nDeleted) {
-    if (nWrite > m_bufferSize) {
+    nDeleted = 0;
+    if (nWrite > capacity() || nWrite == 0) {
         return 0;
     }
-    nDeleted = 0;
-    size_t lastIndex = m_buffer.size() - 1;
-    m_buffer.resize(nWrite + m_buffer.size());
-    std::memcpy(&m_buffer[lastIndex + 1], elementsAddr, nWrite * sizeof(T));
-    if ((lastIndex + nWrite) >= m_bufferSize) {
-        // need to delete elements ahead buffer
-        m_buffer.erase(
-            m_buffer.begin(),
-            m_buffer.begin() + ((lastIndex + nWrite) - m_bufferSize + 1));
-        nDeleted = ((lastIndex + nWrite) - m_bufferSize + 1);
+    copyIn(m_tail, elementsAddr, nWrite);
+    m_tail = wrap(m_tail + nWrite);
+    m_endPosition += nWrite;
+    if (m_size + nWrite > capacity()) {
+        // oldest elements are overwritten
+        nDeleted = m_size + nWrite - capacity();
+        m_head = wrap(m_head + nDeleted);
+        m_size = capacity();
+    } else {
+        m_size += nWrite;
     }
     return nWrite;
 }
 
-template <class T>
-size_t CircularBuffer<T>::getRegion(T* elementsAddr,
+template <typename T, size_t N>
+size_t CircularBuffer<T, N>::getRegion(T* elementsAddr,
                                     size_t index,
                                     size_t nRead) {
-    if (nRead > (m_bufferSize - index)) {
+    if (index > m_size) {
         return 0;
     }
     if (nRead == 0) {
-        nRead = (m_buffer.size() - index);
+        nRead = (m_size - index);
+    }
+    if (nRead > (m_size - index) || nRead == 0) {
+        return 0;
+    }
+    copyOut(elementsAddr, slot(index), nRead);
+    return nRead;
+}
+
+template <typename T, size_t N>
+size_t CircularBuffer<T, N>::getRegionAt(T* elementsAddr,
+                                      uint64_t position,
+                                      size_t nRead) const {
+    if (nRead > capacity() || nRead == 0) {
+        return 0;
     }
-    std::memcpy(elementsAddr, &m_buffer[index], nRead * sizeof(T));
+    copyOut(elementsAddr, wrap(position), nRead);
     return nRead;
 }
 
+template <typename T, size_t N>
+void CircularBuffer<T, N>::getRegionPointersAt(uint64_t position,
+                                            size_t nRead,
+                                            const T*& data1,
+                                            size_t& size1,
+                                            const T*& data2,
+                                            size_t& size2) const {
+    data1 = nullptr;
+    data2 = nullptr;
+    size1 = 0;
+    size2 = 0;
+    if (nRead > capacity() || nRead == 0) {
+        return;
+    }
+    size_t startSlot = wrap(position);
+    size_t nFirst = capacity() - startSlot;
+    data1 = &data()[startSlot];
+    if (nFirst >= nRead || isMirrored()) {
+        size1 = nRead;
+    } else {
+        size1 = nFirst;
+        data2 = &data()[0];
+        size2 = nRead - nFirst;
+    }
+}
+
+template <typename T, size_t N>
+size_t CircularBuffer<T, N>::slot(size_t index) const {
+    return wrap(m_head + index);
+}
+
+template <typename T, size_t N>
+void CircularBuffer<T, N>::copyIn(size_t startSlot, const T* src, size_t n) {
+    size_t nFirst = capacity() - startSlot;
+    if (nFirst >= n || isMirrored()) {
+        std::memcpy(&data()[startSlot], src, n * sizeof(T));
+    } else {
+        std::memcpy(&data()[startSlot], src, nFirst * sizeof(T));
+        std::memcpy(&data()[0], src + nFirst, (n - nFirst) * sizeof(T));
+    }
+}
+
+template <typename T, size_t N>
+void CircularBuffer<T, N>::copyOut(T* dst, size_t startSlot, size_t n) const {
+    size_t nFirst = capacity() - startSlot;
+    if (nFirst >= n || isMirrored()) {
+        std::memcpy(dst, &data()[startSlot], n * sizeof(T));
+    } else {
+        std::memcpy(dst, &data()[startSlot], nFirst * sizeof(T));
+        std::memcpy(dst + nFirst, &data()[0], (n - nFirst) * sizeof(T));
+    }
+}
+
 }  // namespace DataStructures
-}  // namespace Utils
\ No newline at end of file
+}  // namespace Utils
@@ -0,0 +1,77 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <memory>
+#include <string>
+#include <thread>
+
+#include "EventQueue.h"
+
+namespace Utils {
+namespace Threading {
+/**
+ * Runs events in order on its own thread, e.g. observer notifications, so
+ * the thread which raises them never waits for observers. Dispatching is a
+ * push into a lock-free queue, plus a futex wake if the dispatcher thread is
+ * asleep. Time from dispatch until an event starts to run is measured.
+ */
+class EventDispatcher {
+  public:
+    using Event = std::function<void()>;
+
+    /**
+     * @param name used in logs
+     */
+    explicit EventDispatcher(const std::string& name);
+    /**
+     * @brief Runs events which are already dispatched, then stops
+     */
+    ~EventDispatcher();
+
+    /**
+     * @brief Queue @c event to run on dispatcher thread, never blocks.
+     *
+     * @return false if the queue is full and @c event is dropped
+     */
+    bool dispatch(Event event);
+
+    uint64_t getNumEvents() const;
+    uint64_t getNumDroppedEvents() const;
+    /// Time from dispatch to run, averaged over all events
+    std::chrono::microseconds getAverageLatency() const;
+    std::chrono::microseconds getMaxLatency() const;
+
+  private:
+    // noncopyable
+    EventDispatcher(const EventDispatcher&) = delete;
+    EventDispatcher& operator=(const EventDispatcher&) = delete;
+
+    struct QueuedEvent {
+        Event event;
+        std::chrono::steady_clock::time_point dispatchTime;
+    };
+
+    void dispatchLoop();
+    void run(QueuedEvent& queuedEvent);
+
+    /// Max num of events waiting to run
+    static constexpr size_t QUEUE_CAPACITY = 256;
+
+    const std::string m_name;
+    DataStructures::EventQueue<QueuedEvent, QUEUE_CAPACITY> m_queue;
+    // futex word dispatcher thread sleeps on, bumped by dispatch
+    std::atomic<int> m_wakeCounter;
+    std::atomic<bool> m_isSleeping;
+
+    std::atomic<uint64_t> m_numEvents;
+    std::atomic<uint64_t> m_numDroppedEvents;
+    std::atomic<uint64_t> m_totalLatencyUs;
+    std::atomic<uint64_t> m_maxLatencyUs;
+
+    std::atomic<bool> m_isRunning;
+    std::unique_ptr<std::thread> m_dispatchThread;
+};
+}  // namespace Threading
+}  // namespace Utils
@@ -0,0 +1,112 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <utility>
+
+namespace Utils {
+namespace DataStructures {
+/**
+ * Bounded lock-free queue for any number of producers and consumers, with
+ * capacity @c N a power of two. Each slot carries a sequence number telling
+ * whether it is free for the producer or filled for the consumer of a
+ * position, so pushing and popping is one compare exchange on the shared
+ * position, nobody ever waits for a lock holder. Elements are constructed
+ * once and moved in and out.
+ */
+template <typename T, size_t N>
+class EventQueue {
+    static_assert(N > 0 && (N & (N - 1)) == 0,
+                  "Capacity of EventQueue must be a power of two");
+
+  public:
+    EventQueue();
+
+    /**
+     * @brief Move @c element into the queue.
+     *
+     * @return false if the queue is full, @c element is left untouched
+     */
+    bool tryPush(T& element);
+    /**
+     * @brief Move the oldest element into @c element.
+     *
+     * @return false if the queue is empty
+     */
+    bool tryPop(T& element);
+
+  private:
+    // noncopyable
+    EventQueue(const EventQueue&) = delete;
+    EventQueue& operator=(const EventQueue&) = delete;
+
+    struct Slot {
+        std::atomic<size_t> sequence;
+        T element;
+    };
+
+    static constexpr size_t CACHE_LINE_SIZE = 64;
+
+    Slot m_slots[N];
+    // producers and consumers don't share a cache line
+    alignas(CACHE_LINE_SIZE) std::atomic<size_t> m_pushPosition;
+    alignas(CACHE_LINE_SIZE) std::atomic<size_t> m_popPosition;
+};
+
+template <typename T, size_t N>
+EventQueue<T, N>::EventQueue() : m_pushPosition{0}, m_popPosition{0} {
+    for (size_t i = 0; i < N; ++i) {
+        m_slots[i].sequence.store(i, std::memory_order_relaxed);
+    }
+}
+
+template <typename T, size_t N>
+bool EventQueue<T, N>::tryPush(T& element) {
+    size_t position = m_pushPosition.load(std::memory_order_relaxed);
+    while (true) {
+        Slot& slot = m_slots[position & (N - 1)];
+        size_t sequence = slot.sequence.load(std::memory_order_acquire);
+        if (sequence == position) {
+            // slot is free, claim it
+            if (m_pushPosition.compare_exchange_weak(
+                    position, position + 1, std::memory_order_relaxed)) {
+                slot.element = std::move(element);
+                slot.sequence.store(position + 1, std::memory_order_release);
+                return true;
+            }
+        } else if (sequence < position) {
+            // consumer hasn't freed the slot one lap ago, full
+            return false;
+        } else {
+            // another producer took this position
+            position = m_pushPosition.load(std::memory_order_relaxed);
+        }
+    }
+}
+
+template <typename T, size_t N>
+bool EventQueue<T, N>::tryPop(T& element) {
+    size_t position = m_popPosition.load(std::memory_order_relaxed);
+    while (true) {
+        Slot& slot = m_slots[position & (N - 1)];
+        size_t sequence = slot.sequence.load(std::memory_order_acquire);
+        if (sequence == position + 1) {
+            // slot is filled, claim it
+            if (m_popPosition.compare_exchange_weak(
+                    position, position + 1, std::memory_order_relaxed)) {
+                element = std::move(slot.element);
+                // free for the producer of next lap
+                slot.sequence.store(position + N, std::memory_order_release);
+                return true;
+            }
+        } else if (sequence < position + 1) {
+            // producer hasn't filled it yet, empty
+            return false;
+        } else {
+            // another consumer took this position
+            position = m_popPosition.load(std::memory_order_relaxed);
+        }
+    }
+}
+}  // namespace DataStructures
+}  // namespace Utils
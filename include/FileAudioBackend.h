@@ -0,0 +1,110 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "AudioBackend.h"
+
+namespace Audio {
+namespace File {
+/**
+ * @brief Backend without sound card. INPUT plays a WAV or raw file into the
+ * input callback and OUTPUT writes what the output callback gives into a
+ * file, so pipelines can run from recorded corpora on build servers. Each
+ * stream runs on its own thread, paced at @c speed times real time.
+ *
+ * Only interleaved 16 bits samples, INPUT and OUTPUT are supported.
+ */
+class FileAudioBackend : public AudioBackend {
+  public:
+    /**
+     * @brief Construct a new File Audio Backend object. Files are opened by
+     * @c addStream
+     *
+     * @param inputFile file played into INPUT. A ".wav" file must match the
+     * stream config, any other file is raw little endian samples. Empty gives
+     * silence forever
+     * @param outputFile file OUTPUT is written to, ".wav" gets a header.
+     * Empty discards samples
+     * @param speed times of real time. 0 plays INPUT as fast as consumers
+     * take it, OUTPUT is still written at real time
+     */
+    FileAudioBackend(const std::string& inputFile,
+                     const std::string& outputFile = "",
+                     float speed = 1.0f);
+    virtual ~FileAudioBackend();
+
+    void addStream(const AudioBackendConfig& config) override;
+    void startStream(const IOType& type) override;
+    void stopStream(const IOType& type) override;
+    /// Files have no clock, consumers may block INPUT for backpressure
+    bool isRealTime() const override { return false; }
+
+    /**
+     * @brief Wait until INPUT played the whole file.
+     *
+     * @return true if the end is reached, false if timed out
+     */
+    bool waitForInputEnd(std::chrono::milliseconds timeout);
+    // frames passed to or taken from callbacks since the backend is created
+    uint64_t getNumInputFrames() const;
+    uint64_t getNumOutputFrames() const;
+
+  private:
+    struct Stream {
+        AudioBackendConfig config;
+        bool isAdded = false;
+        unsigned long periodSize = 0;
+        // one period, callbacks read and write it
+        std::vector<int16_t> buffer;
+        std::atomic<bool> isRunning{false};
+        std::unique_ptr<std::thread> thread;
+        std::atomic<uint64_t> numFrames{0};
+    };
+
+    // noncopyable
+    FileAudioBackend(const FileAudioBackend&) = delete;
+    FileAudioBackend& operator=(const FileAudioBackend&) = delete;
+
+    // open input file and skip to its samples, throws if it doesn't match
+    void openInputFile(const AudioBackendConfig& config);
+    void openOutputFile(const AudioBackendConfig& config);
+    // write sizes of written samples to WAV header of output file
+    void updateOutputHeader();
+    // run on stream thread until stopped or input file ends
+    void inputLoop();
+    void outputLoop();
+    void joinStream(Stream& stream);
+    // stream of @c type, nullptr if type is invalid
+    Stream* getStream(const IOType& type);
+
+    const std::string m_inputFileName;
+    const std::string m_outputFileName;
+    const float m_speed;
+
+    std::ifstream m_inputFile;
+    // bytes of samples left in input file
+    uint64_t m_inputDataSize;
+    std::ofstream m_outputFile;
+    bool m_isOutputWav;
+    uint64_t m_outputDataSize;
+
+    Stream m_inputStream;
+    Stream m_outputStream;
+
+    std::mutex m_inputEndMtx;
+    std::condition_variable m_cvInputEnd;
+    bool m_isInputEnded;
+
+    std::mutex m_fileMtx;
+};
+}  // namespace File
+}  // namespace Audio
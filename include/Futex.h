@@ -0,0 +1,50 @@
+#pragma once
+
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <climits>
+#include <ctime>
+
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+namespace Utils {
+namespace Threading {
+/**
+ * Thin wrappers of linux futex on a @c std::atomic<int>. The waker side is a
+ * single non-blocking syscall, so it can be used from real-time threads.
+ */
+static_assert(sizeof(std::atomic<int>) == sizeof(int),
+              "std::atomic<int> can't be used as futex word");
+
+/**
+ * @brief Sleep while @c word still equals @c expected, until woken up by
+ * @c futexWake or @c timeout expired.
+ *
+ * @return false if timed out
+ */
+inline bool futexWait(std::atomic<int>& word,
+                      int expected,
+                      std::chrono::nanoseconds timeout) {
+    if (timeout.count() <= 0) {
+        return false;
+    }
+    struct timespec ts;
+    ts.tv_sec = static_cast<time_t>(timeout.count() / 1000000000);
+    ts.tv_nsec = static_cast<long>(timeout.count() % 1000000000);
+    long ret = syscall(SYS_futex, reinterpret_cast<int*>(&word),
+                       FUTEX_WAIT_PRIVATE, expected, &ts, nullptr, 0);
+    return !(ret == -1 && errno == ETIMEDOUT);
+}
+
+/**
+ * @brief Wake up at most @c count threads sleeping on @c word
+ */
+inline void futexWake(std::atomic<int>& word, int count = INT_MAX) {
+    syscall(SYS_futex, reinterpret_cast<int*>(&word), FUTEX_WAKE_PRIVATE, count,
+            nullptr, nullptr, 0);
+}
+}  // namespace Threading
+}  // namespace Utils
@@ -62,8 +62,9 @@ class GoogleVoiceAssistant : public VoiceAssistant,
      * @brief override KeyWordObserverInterface::onKeyWordDetected
      *
      * @param keyWord
+     * @param position absolute position in audio input stream
      */
-    void onKeyWordDetected(std::string keyWord, size_t readerIndex) override;
+    void onKeyWordDetected(std::string keyWord, uint64_t position) override;
     /**
      * @brief override KeyWordObserverInterface::onStateChanged. GVA doesn't
      * care about this
@@ -1,11 +1,14 @@
 #pragma once
+#include <cstdint>
 #include <memory>
 #include <mutex>
 #include <unordered_set>
 
+#include "EventDispatcher.h"
 #include "KeyWordObserverInterface.h"
 /*
- *    Abstract class for KeyWordDetector, using observer pattern
+ *    Abstract class for KeyWordDetector, using observer pattern. Observers
+ *    are called on a dispatcher thread, detection never waits for them
  */
 
 namespace KeyWord {
@@ -18,16 +21,26 @@ class KeyWordDetector {
 
     virtual ~KeyWordDetector() = default;
 
+    /*
+     * Dispatcher of notifications, to measure how long they wait for
+     * observers
+     */
+    const Utils::Threading::EventDispatcher& getEventDispatcher() const;
+
   protected:
     KeyWordDetector();
-    void notifykeyWordObservers(std::string keyWord, size_t readerIndex) const;
+    void notifykeyWordObservers(std::string keyWord, uint64_t position) const;
     void notifykeyWordObservers(
         KeyWordObserverInterface::KeyWordDetectorState state) const;
+    void notifykeyWordObservers(
+        KeyWordObserverInterface::VoiceActivityState state) const;
 
   private:
     std::unordered_set<std::shared_ptr<KeyWordObserverInterface>>
         m_keyWordObservers;
     mutable std::mutex m_keyWordObserversMtx;
     KeyWordObserverInterface::KeyWordDetectorState m_detectorState;
+    // destroyed first, runs notifications left while observers still exist
+    std::unique_ptr<Utils::Threading::EventDispatcher> m_eventDispatcher;
 };
 }  // namespace KeyWord
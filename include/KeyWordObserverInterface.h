@@ -1,4 +1,5 @@
 #pragma once
+#include <cstdint>
 #include <string>
 
 namespace KeyWord {
@@ -9,8 +10,23 @@ class KeyWordObserverInterface {
         ACTIVE,  // KeyWordDetector is active
         STOP     // KeyWordDetector is stopped
     };
+    enum class VoiceActivityState {
+        SILENCE = 0,  // KeyWordDetector only runs VAD
+        SPEECH        // KeyWordDetector runs hot word model
+    };
     virtual ~KeyWordObserverInterface() = default;
-    virtual void onKeyWordDetected(std::string keyWord, size_t readerIndex) = 0;
+    /**
+     * @param position absolute sample position in the audio input stream
+     * where the keyword ends, i.e. end of the frame the detector fired in
+     * minus the detector's latency compensation. Observers can use it to
+     * seek their own readers right after the keyword
+     */
+    virtual void onKeyWordDetected(std::string keyWord, uint64_t position) = 0;
     virtual void onStateChanged(KeyWordDetectorState state) = 0;
+    /**
+     * @brief Called when a detector with a VAD gate finds speech starts or
+     * ends. Ignored by default
+     */
+    virtual void onVoiceActivityChanged(VoiceActivityState /*state*/) {}
 };
 }  // namespace KeyWord
\ No newline at end of file
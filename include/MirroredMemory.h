@@ -0,0 +1,39 @@
+#pragma once
+
+#include <cstddef>
+
+namespace Utils {
+namespace DataStructures {
+/**
+ * @brief Memory region whose pages are mapped twice back-to-back in virtual
+ * memory, so address @c data() + i and @c data() + size() + i refer to the same
+ * byte. A ring buffer using it can address any region, even one crossing the
+ * wrap point, as one continuous pointer.
+ *
+ */
+class MirroredMemory {
+  public:
+    /**
+     * @brief Construct a new Mirrored Memory object. Throws @c BaseException
+     * if mapping failed.
+     *
+     * @param size num of bytes, must be a multiple of @c pageSize()
+     */
+    explicit MirroredMemory(size_t size);
+    ~MirroredMemory();
+
+    void* data() const;
+    size_t size() const;
+
+    static size_t pageSize();
+
+  private:
+    // noncopyable
+    MirroredMemory(const MirroredMemory&) = delete;
+    MirroredMemory& operator=(const MirroredMemory&) = delete;
+
+    void* m_addr;
+    size_t m_size;
+};
+}  // namespace DataStructures
+}  // namespace Utils
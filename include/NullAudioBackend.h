@@ -0,0 +1,20 @@
+#pragma once
+
+#include "FileAudioBackend.h"
+
+namespace Audio {
+namespace File {
+/**
+ * @brief Backend which captures silence and discards everything played, for
+ * running a pipeline without sound card nor corpus.
+ */
+class NullAudioBackend final : public FileAudioBackend {
+  public:
+    /**
+     * @param speed times of real time, 0 runs as fast as possible
+     */
+    explicit NullAudioBackend(float speed = 1.0f)
+        : FileAudioBackend("", "", speed) {}
+};
+}  // namespace File
+}  // namespace Audio
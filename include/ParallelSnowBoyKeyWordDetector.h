@@ -0,0 +1,77 @@
+#pragma once
+
+#include "SnowBoyKeyWordDetector.h"
+
+#include <map>
+
+namespace KeyWord {
+/*
+ *    Shards snowboy models across several SnowBoyKeyWordDetector, each with
+ *    its own SnowBoyWrapper, thread and reader of the same stream, so many
+ *    hot words use all cores instead of one. Detections of all shards are
+ *    merged here, one keyword found by several shards at about the same
+ *    position is notified once. With a VAD config, each shard is gated by
+ *    its own VAD, whose cost is paid once per shard. Voice activity of the
+ *    first shard is notified
+ */
+class ParallelSnowBoyKeyWordDetector : public KeyWordDetector {
+  public:
+    /**
+     * @param readers one reader of the same stream per shard, models are
+     * assigned to shards round robin
+     */
+    ParallelSnowBoyKeyWordDetector(
+        std::vector<std::shared_ptr<Audio::AudioInputStream::Reader>> readers,
+        const std::vector<SnowBoyKeyWordDetector::SnowBoyModelConfig> configs,
+        const std::string& resourceFile,
+        const float audioGain,
+        const bool applyFrontEnd,
+        const std::chrono::milliseconds frameDuration =
+            std::chrono::milliseconds(10),
+        const SnowBoyVadConfig& vadConfig = SnowBoyVadConfig());
+    ~ParallelSnowBoyKeyWordDetector();
+
+    size_t getNumShards() const;
+    /// Num of detections notified, duplicates excluded
+    uint64_t getNumDetections() const;
+    uint64_t getNumDuplicates() const;
+    /// Worst detection latency of all shards
+    std::chrono::microseconds getMaxDetectionLatency() const;
+    /// Samples every shard is done with, i.e. of the slowest shard
+    uint64_t getNumProcessedSamples() const;
+
+  private:
+    // forwards notifications of one shard to the merger
+    class ShardObserver : public KeyWordObserverInterface {
+      public:
+        ShardObserver(ParallelSnowBoyKeyWordDetector& detector,
+                      size_t shardIndex);
+        void onKeyWordDetected(std::string keyWord,
+                               uint64_t position) override;
+        void onStateChanged(KeyWordDetectorState state) override;
+        void onVoiceActivityChanged(VoiceActivityState state) override;
+
+      private:
+        ParallelSnowBoyKeyWordDetector& m_detector;
+        const size_t m_shardIndex;
+    };
+
+    void onShardKeyWordDetected(const std::string& keyWord, uint64_t position);
+    void onShardStateChanged(
+        KeyWordObserverInterface::KeyWordDetectorState state);
+
+    size_t m_numShards;
+    // guards everything below, shards notify from their own threads
+    mutable std::mutex m_mergeMtx;
+    // last notified position of each keyword
+    std::map<std::string, uint64_t> m_lastDetectionPositions;
+    // last state notified, each shard reports the same states
+    KeyWordObserverInterface::KeyWordDetectorState m_state;
+    uint64_t m_numDetections;
+    uint64_t m_numDuplicates;
+
+    std::vector<std::shared_ptr<ShardObserver>> m_shardObservers;
+    // destroyed first, so shards stop notifying before the merger goes
+    std::vector<std::unique_ptr<SnowBoyKeyWordDetector>> m_shards;
+};
+}  // namespace KeyWord
@@ -1,7 +1,7 @@
 #pragma once
 
+#include "AudioBackend.h"
 #include "AudioStream.h"
-#include "PortAudioWrapper.h"
 
 namespace Audio {
 namespace Player {
@@ -11,13 +11,21 @@ class Player {
            const int bitsPerSample,
            const int numChannels,
            std::shared_ptr<AudioOutputStream::Reader> reader,
-           std::shared_ptr<PortAudio::PortAudioWrapper> portAudioWrapper);
+           std::shared_ptr<AudioBackend> audioBackend);
     ~Player();
 
     void startPlay();
     void stopPlay();
     bool isPlaying() const;
     bool hasDataToPlay() const;
+    /*
+     * Num of samples filled with silence because the stream had no data, and
+     * num of callbacks which did so, since the player is created
+     */
+    uint64_t getNumUnderrunSamples() const;
+    uint64_t getNumUnderruns() const;
+    /// Num of times the device itself ran out of data, reported by backend
+    uint64_t getNumOutputUnderflows() const;
 
     const int m_sampleRate;
     const int m_bitsPerSample;
@@ -28,11 +36,26 @@ class Player {
     Player(const Player&) = delete;
     Player& operator=(const Player&) = delete;
 
-    std::shared_ptr<PortAudio::PortAudioWrapper> m_portAudioWrapper;
+    /*
+     * Playback callback, runs on the backend audio thread. Reads straight
+     * into the device buffer, never allocates, locks or logs
+     */
+    static void onAudioRequested(void* data,
+                                 unsigned long numSamples,
+                                 unsigned long statusFlags,
+                                 void* userData);
+
+    std::shared_ptr<AudioBackend> m_audioBackend;
     std::shared_ptr<AudioOutputStream::Reader> m_reader;
     std::atomic<bool> m_isReady;
     std::atomic<bool> m_isPlaying;
     std::atomic<bool> m_hasDataToPlay;
+    // written by playback callback only
+    std::atomic<uint64_t> m_numUnderrunSamples;
+    std::atomic<uint64_t> m_numUnderruns;
+    std::atomic<uint64_t> m_numOutputUnderflows;
+    // underrun samples already logged by stopPlay
+    uint64_t m_reportedUnderrunSamples;
 };
 }  // namespace Player
 }  // namespace Audio
@@ -1,36 +1,128 @@
 #pragma once
 
+#include "AudioBackend.h"
 #include "pa_ringbuffer.h"
 #include "portaudio.h"
 
-#include <functional>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
 #include <memory>
 #include <mutex>
 #include <vector>
 
 namespace Audio {
 namespace PortAudio {
-enum class IOType {
-    INPUT = 0,  // PortAudio will have input capture
-    OUTPUT      // PortAudio will have output
+using Audio::IOType;
+
+/// Buckets of callback duration histogram, see @c StreamStatistics
+static constexpr size_t NUM_CALLBACK_DURATION_BUCKETS = 16;
+
+/**
+ * Snapshot of statistics of one stream since it is added
+ */
+struct StreamStatistics {
+    uint64_t numCallbacks;
+    // status flags reported by PortAudio
+    uint64_t numInputOverflows;
+    uint64_t numInputUnderflows;
+    uint64_t numOutputOverflows;
+    uint64_t numOutputUnderflows;
+    // bucket 0 counts callbacks shorter than 1 us, bucket i counts
+    // [2^(i-1), 2^i) us, the last one also counts everything longer
+    std::array<uint64_t, NUM_CALLBACK_DURATION_BUCKETS>
+        callbackDurationHistogram;
+    uint64_t maxCallbackDurationUs;
+    // ADC to callback and callback to DAC latency of last callback and the
+    // max ever seen, in us, from PaStreamCallbackTimeInfo
+    int64_t inputLatencyUs;
+    int64_t maxInputLatencyUs;
+    int64_t outputLatencyUs;
+    int64_t maxOutputLatencyUs;
+    // Pa_GetStreamCpuLoad, 0 if stream is not added
+    double cpuLoad;
 };
 
-class PortAudioWrapper final {
+/**
+ * @brief @c AudioBackend on top of PortAudio default devices. Besides the
+ * generic interface, it takes PortAudio specific configs, DUPLEX streams and
+ * reports stream statistics.
+ */
+class PortAudioWrapper final : public AudioBackend {
   public:
+    /**
+     * @brief Called on the PortAudio audio thread with captured samples. A
+     * plain function pointer so calling it can't allocate, it must not
+     * allocate, lock, log or make syscalls either.
+     *
+     * @param statusFlags PortAudio status flags, e.g. paInputOverflow
+     */
+    using InputCallback = void (*)(const void* data,
+                                   unsigned long numSamples,
+                                   PaStreamCallbackFlags statusFlags,
+                                   void* userData);
+    /**
+     * @brief Called on the PortAudio audio thread to fill the device buffer
+     * with @c numSamples frames. Same restrictions as @c InputCallback.
+     *
+     * @param statusFlags PortAudio status flags, e.g. paOutputUnderflow
+     */
+    using OutputCallback = void (*)(void* data,
+                                    unsigned long numSamples,
+                                    PaStreamCallbackFlags statusFlags,
+                                    void* userData);
+    /**
+     * @brief Called on the PortAudio audio thread of a DUPLEX stream with the
+     * captured frames and the device buffer to fill, of the same period. Same
+     * restrictions as @c InputCallback.
+     *
+     * @param timeInfo capture time of @c input and playback time of
+     * @c output on the same clock
+     */
+    using DuplexCallback = void (*)(const void* input,
+                                    void* output,
+                                    unsigned long numSamples,
+                                    const PaStreamCallbackTimeInfo* timeInfo,
+                                    PaStreamCallbackFlags statusFlags,
+                                    void* userData);
+
     struct PortAudioWrapperConfig {
         int sampleRate;
         int numChannels;
         int bitsPerSample;
         IOType type;
-        std::function<void(const void*, unsigned long)> inputCallbackInterface;
-        std::function<void(void*, unsigned long)> outputCallbackInterface;
+        // native format of device, e.g. paFloat32 for mic arrays
+        PaSampleFormat sampleFormat = paInt16;
+        InputCallback inputCallback = nullptr;
+        // passed to @c inputCallback as it is
+        void* inputUserData = nullptr;
+        OutputCallback outputCallback = nullptr;
+        // passed to @c outputCallback as it is
+        void* outputUserData = nullptr;
+        DuplexCallback duplexCallback = nullptr;
+        // passed to @c duplexCallback as it is
+        void* duplexUserData = nullptr;
+        // output channels of a DUPLEX stream, 0 means same as numChannels
+        int outputNumChannels = 0;
+        // frames per callback, paFramesPerBufferUnspecified lets the host
+        // choose the best one
+        unsigned long framesPerBuffer = paFramesPerBufferUnspecified;
+        // in seconds, 0 means default low latency of the device
+        PaTime suggestedLatency = 0;
+        // e.g. paPrimeOutputBuffersUsingStreamCallback
+        PaStreamFlags streamFlags = paNoFlag;
     };
     /**
      * @brief Construct a new Port Audio Wrapper object. Before use it,
      * @c addStream first
      *
+     * @param isDuplex generic INPUT and OUTPUT streams, e.g. of @c Recorder
+     * and @c Player, share one DUPLEX stream on the same clock. They must
+     * agree on sample rate, channels and format. The DUPLEX stream is opened
+     * once both are added and runs while either of them is started
      */
-    PortAudioWrapper();
+    explicit PortAudioWrapper(bool isDuplex = false);
     /**
      * @brief Destroy the Port Audio Wrapper object
      *
@@ -43,11 +135,46 @@ class PortAudioWrapper final {
      * @param config
      */
     void addStream(const PortAudioWrapperConfig& config);
+    /**
+     * @brief add INPUT or OUTPUT stream with generic @c config. OUTPUT
+     * streams prime device buffers with the callback instead of silence.
+     */
+    void addStream(const AudioBackendConfig& config) override;
 
-    void startStream(const IOType& type);
-    void stopStream(const IOType& type);
+    void startStream(const IOType& type) override;
+    void stopStream(const IOType& type) override;
+    /**
+     * @brief Latency achieved by the opened stream, which may differ from
+     * the suggested one. For DUPLEX it is input plus output latency.
+     *
+     * @return latency in seconds, 0 if the stream is not added
+     */
+    PaTime getStreamLatency(const IOType& type);
+    /**
+     * @brief Statistics of stream @c type. Only reads atomic counters which
+     * callbacks update, cheap enough to be polled by a monitoring thread.
+     */
+    StreamStatistics getStreamStatistics(const IOType& type);
 
   private:
+    /**
+     * Counters of one stream, written only by its callback
+     */
+    struct StreamCounters {
+        std::atomic<uint64_t> numCallbacks;
+        std::atomic<uint64_t> numInputOverflows;
+        std::atomic<uint64_t> numInputUnderflows;
+        std::atomic<uint64_t> numOutputOverflows;
+        std::atomic<uint64_t> numOutputUnderflows;
+        std::array<std::atomic<uint64_t>, NUM_CALLBACK_DURATION_BUCKETS>
+            callbackDurationHistogram;
+        std::atomic<uint64_t> maxCallbackDurationUs;
+        std::atomic<int64_t> inputLatencyUs;
+        std::atomic<int64_t> maxInputLatencyUs;
+        std::atomic<int64_t> outputLatencyUs;
+        std::atomic<int64_t> maxOutputLatencyUs;
+    };
+
     /**
      * @brief Portaudio will call this function once sampling is done
      *
@@ -73,13 +200,70 @@ class PortAudioWrapper final {
                                        PaStreamCallbackFlags statusFlags,
                                        void* userData);
 
-    std::function<void(const void*, unsigned long)> m_inputCallbackInterface;
-    std::function<void(void*, unsigned long)> m_outputCallbackInterface;
+    static int portAudioDuplexCallback(const void* inputBuffer,
+                                       void* outputBuffer,
+                                       unsigned long numSamples,
+                                       const PaStreamCallbackTimeInfo* timeInfo,
+                                       PaStreamCallbackFlags statusFlags,
+                                       void* userData);
+
+    /*
+     * DuplexCallback of a shared DUPLEX stream, forwards both directions to
+     * callbacks of generic INPUT and OUTPUT streams which are started, plays
+     * silence if OUTPUT is stopped
+     */
+    static void forwardDuplexCallback(const void* input,
+                                      void* output,
+                                      unsigned long numSamples,
+                                      const PaStreamCallbackTimeInfo* timeInfo,
+                                      PaStreamCallbackFlags statusFlags,
+                                      void* userData);
+
+    // stream of @c type, nullptr if type is invalid
+    PaStream** getStream(const IOType& type);
+    // keep generic @c config for the shared DUPLEX stream, open it once both
+    // directions are there
+    void addSharedStream(const PortAudioWrapperConfig& config);
+    void startSharedStream(const IOType& type);
+    void stopSharedStream(const IOType& type);
+    /*
+     * Update counters of stream @c type after its callback returned, called
+     * on the audio thread
+     */
+    void updateCounters(const IOType& type,
+                        const PaStreamCallbackTimeInfo* timeInfo,
+                        PaStreamCallbackFlags statusFlags,
+                        std::chrono::steady_clock::time_point callbackStart);
+
+    InputCallback m_inputCallback;
+    void* m_inputUserData;
+    OutputCallback m_outputCallback;
+    void* m_outputUserData;
+    DuplexCallback m_duplexCallback;
+    void* m_duplexUserData;
+
+    const bool m_isDuplex;
+    // generic streams added to the shared DUPLEX stream so far
+    PortAudioWrapperConfig m_sharedConfig;
+    bool m_hasSharedInput;
+    bool m_hasSharedOutput;
+    // bytes of one output frame of the shared DUPLEX stream
+    size_t m_sharedOutputFrameSize;
+    // directions started on the shared DUPLEX stream, read by its callback
+    std::atomic<bool> m_isSharedInputStarted;
+    std::atomic<bool> m_isSharedOutputStarted;
 
     // stream memory will be controlled by portaudio itself, so we don't use
     // smart pointer here
     PaStream* m_paInputStream;
     PaStream* m_paOutputStream;
+    PaStream* m_paDuplexStream;
+    PaTime m_inputLatency;
+    PaTime m_outputLatency;
+    PaTime m_duplexLatency;
+
+    // indexed by IOType, zero initialized
+    StreamCounters m_streamCounters[3] = {};
 
     std::mutex m_portAudioMtx;
 };
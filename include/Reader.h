@@ -1,91 +1,504 @@
 #pragma once
 
+#include <chrono>
+
 #include "SharedDataStream.h"
 
 namespace Utils {
 namespace DataStructures {
-template <typename T>
-class SharedDataStream<T>::Reader {
+template <typename T, size_t N>
+class SharedDataStream<T, N>::Reader {
   public:
-    Reader(SharedDataStream<T>& sharedDataStream);
+    /*
+     * Region of data inside the stream storage returned by @c peek. Because of
+     * the wrap point, it may be split into two continuous parts, @c size2 is 0
+     * if the region is continuous, which is always the case for mirrored
+     * storage. Same as PaUtil_GetRingBufferReadRegions. @c position is the
+     * absolute position of @c data1[0], overrun data is skipped by @c peek so
+     * it may be ahead of @c getPosition
+     */
+    struct ReadRegions {
+        const T* data1;
+        size_t size1;
+        const T* data2;
+        size_t size2;
+        uint64_t position;
+        size_t size() const { return size1 + size2; }
+    };
+
+    /*
+     * Called in the reader's thread when the reader finds out that the writer
+     * has overwritten @c lostNum elements from @c position which it hasn't
+     * read yet
+     */
+    using OverrunCallback =
+        std::function<void(uint64_t position, size_t lostNum)>;
+
+    /*
+     * Created by @c SharedDataStream::createReader, deregisters itself when
+     * destroyed
+     */
+    Reader(SharedDataStream<T, N>& sharedDataStream, ReaderSlot& slot);
     ~Reader();
     /*
-     * if @c nRead == 0, will read everything it can read
+     * if @c nRead == 0, will read everything it can read. Reading doesn't take
+     * any lock. If the writer has overrun this reader, reading restarts from
+     * the oldest data still in the stream and the overrun is reported
      */
     size_t read(T* buf, size_t nRead);
-    void updateIndex(size_t nDeleted);
+    /*
+     * Real-time safe version of @c read for audio callbacks, reads at most
+     * @c maxRead elements, less if less is available. Never blocks, allocates
+     * or logs, the overrun callback is still called if it is set.
+     * @return num of elements read, 0 if nothing is available
+     */
+    size_t tryRead(T* buf, size_t maxRead);
+    /*
+     * Sleep until the writer has published at least @c minSamples elements
+     * for this reader, then read at most @c maxSamples elements.
+     * If the writer is closed, wakes up and returns what is left even if
+     * it is less than @c minSamples.
+     * @return num of elements read. return 0 if timeout, or right away at the
+     * end of stream, see @c isWriterClosed
+     */
+    size_t waitRead(T* buf,
+                    size_t minSamples,
+                    size_t maxSamples,
+                    std::chrono::milliseconds timeout);
+    /*
+     * Sleep until the writer has published at least @c minSamples elements
+     * for this reader, without reading anything.
+     * @return num of elements available, return 0 if timeout, or right away
+     * if the writer is closed and everything is read
+     */
+    size_t wait(size_t minSamples, std::chrono::milliseconds timeout);
+    /*
+     * Whether the writer is closed. Together with @c wait returning 0 it means
+     * the end of stream, until the writer is opened again
+     */
+    bool isWriterClosed() const;
+    /*
+     * Get at most @c nPeek elements straight from the stream storage without
+     * copying. if @c nPeek == 0, will peek everything it can read. Peeked data
+     * must be released by @c consume
+     */
+    ReadRegions peek(size_t nPeek);
+    /*
+     * Advance the reader after using the region returned by last @c peek.
+     * @return false if the writer overwrote the peeked data while it was
+     * being used, or the reader was moved by @c setPosition after @c peek
+     */
+    bool consume(size_t nConsume);
     size_t getAvailableNum();
-    size_t getIndex() const;
-    void setIndex(size_t index);
+    /*
+     * Absolute position in the stream of the next element to read. Positions
+     * are shared by all readers of the same stream and never shift when the
+     * writer writes
+     */
+    uint64_t getPosition() const;
+    /*
+     * Move the reader to an absolute position. Positions which are already
+     * overwritten or not written yet are clamped to the valid range
+     */
+    void setPosition(uint64_t position);
+    /*
+     * Set before the reader starts reading, it is not synchronized with
+     * reading
+     */
+    void setOverrunCallback(OverrunCallback overrunCallback);
+    /*
+     * With OverflowPolicy::BLOCK_WRITER, whether the writer waits for this
+     * reader, true by default. A reader which only reads now and then, e.g.
+     * after a keyword, is overrun like with DROP_OLDEST if it's false
+     */
+    void setBlockingWriter(bool isBlockingWriter);
+    /*
+     * Num of times this reader was overrun by the writer, and total num of
+     * elements it lost. Can be called from any thread
+     */
+    uint64_t getOverrunCount() const;
+    uint64_t getOverrunNum() const;
 
   private:
-    SharedDataStream<T>& m_sharedDataStream;
-    std::atomic<size_t>
-        m_index;  // to avoid one reader read same data twice, mark the index
-                  // as last time read position + 1 sizeof(T)
+    friend class SharedDataStream<T, N>;
+
+    // noncopyable
+    Reader(const Reader&) = delete;
+    Reader& operator=(const Reader&) = delete;
+
+    // check if the reader can still be used, log with @c operation if not
+    bool isRegistered(const char* operation) const;
+    /*
+     * Shared by @c read and @c tryRead. With @c isRealTime set, reads what is
+     * available up to @c nRead and doesn't log
+     */
+    size_t readImpl(T* buf, size_t nRead, bool isRealTime);
+    void reportOverrun(uint64_t position,
+                       size_t lostNum,
+                       bool shouldLog = true);
+
+    // retry times when the writer overwrites the region while reading it
+    static constexpr int MAX_READ_RETRIES = 3;
+
+    SharedDataStream<T, N>& m_sharedDataStream;
+    ReaderSlot& m_slot;
+    std::atomic<uint64_t>&
+        m_readPosition;  // to avoid one reader read same data twice, mark the
+                         // position of next element to read, lives in
+                         // m_slot so the writer can see it
+    // read position when last peek happened, and where the region started
+    uint64_t m_peekBasePosition;
+    uint64_t m_peekPosition;
+    size_t m_peekSize;
+    std::atomic<uint64_t> m_overrunCount;
+    std::atomic<uint64_t> m_overrunNum;
+    OverrunCallback m_overrunCallback;
 };
 
-template <typename T>
-SharedDataStream<T>::Reader::Reader(SharedDataStream<T>& sharedDataStream)
-    : m_sharedDataStream{sharedDataStream}, m_index{0} {
+template <typename T, size_t N>
+SharedDataStream<T, N>::Reader::Reader(SharedDataStream<T, N>& sharedDataStream,
+                                       ReaderSlot& slot)
+    : m_sharedDataStream{sharedDataStream},
+      m_slot{slot},
+      m_readPosition{slot.position},
+      m_peekBasePosition{0},
+      m_peekPosition{0},
+      m_peekSize{0},
+      m_overrunCount{0},
+      m_overrunNum{0} {
     BasicLogger::getInstance().log(typeid(*this).name(), LogLevel::DEBUG,
                                    "Constructor called");
 }
 
-template <typename T>
-SharedDataStream<T>::Reader::~Reader() {}
+template <typename T, size_t N>
+SharedDataStream<T, N>::Reader::~Reader() {
+    m_slot.isRegistered.store(false, std::memory_order_release);
+    m_slot.isUsed.store(false, std::memory_order_release);
+    // writer may be waiting for this reader
+    m_sharedDataStream.notifyWriter();
+    BasicLogger::getInstance().log(typeid(*this).name(), LogLevel::DEBUG,
+                                   "Destructor called");
+}
 
-template <typename T>
-size_t SharedDataStream<T>::Reader::read(T* buf, size_t nRead) {
+template <typename T, size_t N>
+size_t SharedDataStream<T, N>::Reader::read(T* buf, size_t nRead) {
     if (!m_sharedDataStream.isReady) {
         BasicLogger::getInstance().log(
             typeid(*this).name(), LogLevel::ERROR,
             "Someone trying to read data from a unready SharedDataStream");
         return 0;
     }
+    if (!isRegistered("read")) {
+        return 0;
+    }
     if (nullptr == buf) {
         BasicLogger::getInstance().log(
             typeid(*this).name(), LogLevel::ERROR,
             "Someone trying to write to nullptr from SharedDataStream");
         return 0;
     }
-    if (nRead > (m_sharedDataStream.m_circularBuffer->size())) {
+    if (nRead > m_sharedDataStream.m_capacity) {
         BasicLogger::getInstance().log(typeid(*this).name(), LogLevel::ERROR,
                                        "read: required read num is too much");
         return 0;
     }
 
-    std::lock_guard<std::mutex> lock(m_sharedDataStream.m_circularBufferMtx);
-    size_t ret = 0;
+    return readImpl(buf, nRead, false);
+}
+
+template <typename T, size_t N>
+size_t SharedDataStream<T, N>::Reader::tryRead(T* buf, size_t maxRead) {
+    if (!m_sharedDataStream.isReady ||
+        !m_slot.isRegistered.load(std::memory_order_relaxed) ||
+        nullptr == buf || maxRead == 0) {
+        return 0;
+    }
+    return readImpl(buf, maxRead, true);
+}
+
+template <typename T, size_t N>
+size_t SharedDataStream<T, N>::Reader::readImpl(T* buf,
+                                                size_t nRead,
+                                                bool isRealTime) {
+    for (int retry = 0; retry < MAX_READ_RETRIES; retry++) {
+        uint64_t writeSequence = m_sharedDataStream.m_writeSequence.load(
+            std::memory_order_acquire);
+        uint64_t oldestSequence =
+            m_sharedDataStream.oldestSequence(writeSequence);
+        uint64_t position = m_readPosition.load(std::memory_order_relaxed);
+        uint64_t readSequence =
+            position < oldestSequence ? oldestSequence : position;
+
+        size_t available = writeSequence - readSequence;
+        size_t num = (nRead == 0) ? available : nRead;
+        if (isRealTime && num > available) {
+            num = available;
+        }
+        if (num == 0 || num > available) {
+            if (!isRealTime) {
+                BasicLogger::getInstance().log(typeid(*this).name(),
+                                               LogLevel::ERROR,
+                                               "read: read nothing");
+            }
+            return 0;
+        }
+
+        m_sharedDataStream.m_circularBuffer.getRegionAt(buf, readSequence,
+                                                         num);
 
-    ret = m_sharedDataStream.m_circularBuffer->getRegion(buf, m_index, nRead);
-    if (ret == 0) {
+        // make sure the copy is done before checking if writer touched it
+        std::atomic_thread_fence(std::memory_order_acquire);
+        uint64_t reserveSequence = m_sharedDataStream.m_reserveSequence.load(
+            std::memory_order_relaxed);
+        if (reserveSequence <= readSequence + m_sharedDataStream.m_capacity &&
+            m_readPosition.compare_exchange_strong(position,
+                                                   readSequence + num)) {
+            if (readSequence > position) {
+                reportOverrun(position, readSequence - position, !isRealTime);
+            }
+            m_sharedDataStream.notifyWriter();
+            return num;
+        }
+        // writer overwrote the region while copying, or someone moved the
+        // reader by setPosition, try again
+    }
+    if (!isRealTime) {
         BasicLogger::getInstance().log(typeid(*this).name(), LogLevel::ERROR,
-                                       "read: read nothing");
+                                       "read: overrun by writer while reading");
     }
-    m_index += ret;
-    return ret;
+    return 0;
 }
 
-template <typename T>
-void SharedDataStream<T>::Reader::updateIndex(size_t nDeleted) {
-    m_index = (m_index > nDeleted) ? (m_index - nDeleted) : 0;
+template <typename T, size_t N>
+size_t SharedDataStream<T, N>::Reader::waitRead(
+    T* buf,
+    size_t minSamples,
+    size_t maxSamples,
+    std::chrono::milliseconds timeout) {
+    if (minSamples == 0) {
+        minSamples = 1;
+    }
+    if (maxSamples > m_sharedDataStream.m_capacity) {
+        maxSamples = m_sharedDataStream.m_capacity;
+    }
+    if (minSamples > maxSamples) {
+        BasicLogger::getInstance().log(typeid(*this).name(), LogLevel::ERROR,
+                                       "waitRead: Invalid parameter");
+        return 0;
+    }
+
+    size_t available = wait(minSamples, timeout);
+    if (available == 0) {
+        return 0;
+    }
+    return read(buf, available > maxSamples ? maxSamples : available);
 }
 
-template <typename T>
-size_t SharedDataStream<T>::Reader::getAvailableNum() {
-    return (m_sharedDataStream.m_circularBuffer->size() - m_index);
+template <typename T, size_t N>
+size_t SharedDataStream<T, N>::Reader::wait(size_t minSamples,
+                                            std::chrono::milliseconds timeout) {
+    if (minSamples == 0) {
+        minSamples = 1;
+    }
+    if (minSamples > m_sharedDataStream.m_capacity) {
+        BasicLogger::getInstance().log(typeid(*this).name(), LogLevel::ERROR,
+                                       "wait: Invalid parameter");
+        return 0;
+    }
+    if (!isRegistered("wait")) {
+        return 0;
+    }
+
+    // when writer is closed, don't wait for more than what is already there.
+    // The flag is loaded first, so everything written before closing is seen
+    bool isClosed = false;
+    auto readableNum = [this, minSamples, &isClosed]() -> size_t {
+        isClosed = m_sharedDataStream.m_isWriterClosed;
+        size_t available = getAvailableNum();
+        if (available >= minSamples || (available > 0 && isClosed)) {
+            return available;
+        }
+        return 0;
+    };
+
+    auto deadline = std::chrono::steady_clock::now() + timeout;
+    while (true) {
+        size_t available = readableNum();
+        if (available > 0 || isClosed) {
+            // 0 with closed writer is the end of stream
+            return available;
+        }
+        auto now = std::chrono::steady_clock::now();
+        if (now >= deadline) {
+            return 0;
+        }
+
+        m_sharedDataStream.m_numWaitingReaders.fetch_add(1);
+        int wakeCounter =
+            m_sharedDataStream.m_wakeCounter.load(std::memory_order_acquire);
+        // check again after registered as waiter, the writer may have
+        // published before it could see us
+        if (readableNum() == 0 && !isClosed) {
+            Utils::Threading::futexWait(m_sharedDataStream.m_wakeCounter,
+                                        wakeCounter, deadline - now);
+        }
+        m_sharedDataStream.m_numWaitingReaders.fetch_sub(1);
+    }
 }
 
-template <typename T>
-size_t SharedDataStream<T>::Reader::getIndex() const {
-    return m_index;
+template <typename T, size_t N>
+typename SharedDataStream<T, N>::Reader::ReadRegions
+SharedDataStream<T, N>::Reader::peek(size_t nPeek) {
+    ReadRegions regions{nullptr, 0, nullptr, 0, 0};
+    if (!m_sharedDataStream.isReady) {
+        BasicLogger::getInstance().log(
+            typeid(*this).name(), LogLevel::ERROR,
+            "Someone trying to peek data from a unready SharedDataStream");
+        return regions;
+    }
+    if (!isRegistered("peek")) {
+        return regions;
+    }
+
+    uint64_t writeSequence =
+        m_sharedDataStream.m_writeSequence.load(std::memory_order_acquire);
+    uint64_t oldestSequence = m_sharedDataStream.oldestSequence(writeSequence);
+    m_peekBasePosition = m_readPosition.load(std::memory_order_relaxed);
+    m_peekPosition = m_peekBasePosition < oldestSequence ? oldestSequence
+                                                         : m_peekBasePosition;
+    regions.position = m_peekPosition;
+    size_t available = writeSequence - m_peekPosition;
+    m_peekSize = (nPeek == 0 || nPeek > available) ? available : nPeek;
+
+    m_sharedDataStream.m_circularBuffer.getRegionPointersAt(
+        m_peekPosition, m_peekSize, regions.data1, regions.size1,
+        regions.data2, regions.size2);
+    return regions;
 }
 
-template <typename T>
-void SharedDataStream<T>::Reader::setIndex(size_t index) {
-    m_index = index;
+template <typename T, size_t N>
+bool SharedDataStream<T, N>::Reader::consume(size_t nConsume) {
+    if (nConsume > m_peekSize) {
+        BasicLogger::getInstance().log(
+            typeid(*this).name(), LogLevel::ERROR,
+            "consume: required consume num is more than peeked");
+        nConsume = m_peekSize;
+    }
+    // make sure the caller is done with the data before checking if writer
+    // touched it
+    std::atomic_thread_fence(std::memory_order_acquire);
+    uint64_t reserveSequence =
+        m_sharedDataStream.m_reserveSequence.load(std::memory_order_relaxed);
+    bool isIntact =
+        reserveSequence <= m_peekPosition + m_sharedDataStream.m_capacity;
+
+    uint64_t expected = m_peekBasePosition;
+    if (!m_readPosition.compare_exchange_strong(expected,
+                                                m_peekPosition + nConsume)) {
+        // moved by setPosition, keep the new position
+        m_peekSize = 0;
+        return false;
+    }
+    if (m_peekPosition > m_peekBasePosition) {
+        reportOverrun(m_peekBasePosition, m_peekPosition - m_peekBasePosition);
+    }
+    if (!isIntact) {
+        // part of the peeked region was overwritten while it was being used
+        uint64_t tornNum =
+            reserveSequence - m_sharedDataStream.m_capacity - m_peekPosition;
+        reportOverrun(m_peekPosition, tornNum < nConsume ? tornNum : nConsume);
+    }
+    m_sharedDataStream.notifyWriter();
+    m_peekSize = 0;
+    return isIntact;
+}
+
+template <typename T, size_t N>
+size_t SharedDataStream<T, N>::Reader::getAvailableNum() {
+    uint64_t writeSequence =
+        m_sharedDataStream.m_writeSequence.load(std::memory_order_acquire);
+    uint64_t oldestSequence = m_sharedDataStream.oldestSequence(writeSequence);
+    uint64_t readSequence = m_readPosition.load(std::memory_order_relaxed);
+    if (readSequence < oldestSequence) {
+        readSequence = oldestSequence;
+    }
+    return writeSequence - readSequence;
+}
+
+template <typename T, size_t N>
+bool SharedDataStream<T, N>::Reader::isWriterClosed() const {
+    return m_sharedDataStream.m_isWriterClosed;
+}
+
+template <typename T, size_t N>
+uint64_t SharedDataStream<T, N>::Reader::getPosition() const {
+    return m_readPosition.load(std::memory_order_relaxed);
+}
+
+template <typename T, size_t N>
+void SharedDataStream<T, N>::Reader::setPosition(uint64_t position) {
+    uint64_t writeSequence =
+        m_sharedDataStream.m_writeSequence.load(std::memory_order_acquire);
+    uint64_t oldestSequence = m_sharedDataStream.oldestSequence(writeSequence);
+    if (position < oldestSequence) {
+        position = oldestSequence;
+    } else if (position > writeSequence) {
+        position = writeSequence;
+    }
+    m_readPosition.store(position, std::memory_order_release);
+    m_sharedDataStream.notifyWriter();
+}
+
+template <typename T, size_t N>
+void SharedDataStream<T, N>::Reader::setOverrunCallback(
+    OverrunCallback overrunCallback) {
+    m_overrunCallback = overrunCallback;
+}
+
+template <typename T, size_t N>
+void SharedDataStream<T, N>::Reader::setBlockingWriter(bool isBlockingWriter) {
+    m_slot.isBlockingWriter.store(isBlockingWriter, std::memory_order_relaxed);
+    // writer may be waiting for this reader
+    m_sharedDataStream.notifyWriter();
+}
+
+template <typename T, size_t N>
+uint64_t SharedDataStream<T, N>::Reader::getOverrunCount() const {
+    return m_overrunCount.load(std::memory_order_relaxed);
+}
+
+template <typename T, size_t N>
+uint64_t SharedDataStream<T, N>::Reader::getOverrunNum() const {
+    return m_overrunNum.load(std::memory_order_relaxed);
+}
+
+template <typename T, size_t N>
+bool SharedDataStream<T, N>::Reader::isRegistered(const char* operation) const {
+    if (!m_slot.isRegistered.load(std::memory_order_relaxed)) {
+        BasicLogger::getInstance().log(
+            typeid(*this).name(), LogLevel::ERROR,
+            std::string(operation) + ": reader is removed from stream");
+        return false;
+    }
+    return true;
+}
+
+template <typename T, size_t N>
+void SharedDataStream<T, N>::Reader::reportOverrun(uint64_t position,
+                                                   size_t lostNum,
+                                                   bool shouldLog) {
+    m_sharedDataStream.m_overrunCount.fetch_add(1, std::memory_order_relaxed);
+    m_overrunCount.fetch_add(1, std::memory_order_relaxed);
+    m_overrunNum.fetch_add(lostNum, std::memory_order_relaxed);
+    if (shouldLog) {
+        BasicLogger::getInstance().log(
+            typeid(*this).name(), LogLevel::WARNING,
+            "overrun by writer, lost " + std::to_string(lostNum) + " elements");
+    }
+    if (m_overrunCallback) {
+        m_overrunCallback(position, lostNum);
+    }
 }
 
 }  // namespace DataStructures
-}  // namespace Utils
\ No newline at end of file
+}  // namespace Utils
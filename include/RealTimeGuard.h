@@ -0,0 +1,47 @@
+#pragma once
+
+namespace Utils {
+namespace RealTime {
+/**
+ * Debug hook for code running on audio callback threads, which must not
+ * allocate memory or lock a mutex. Build with REALTIME_GUARD defined
+ * (`make debug`) and every malloc/calloc/realloc or pthread_mutex_lock on a
+ * thread inside a @c RealTimeScope calls the violation handler, which aborts
+ * by default. Without REALTIME_GUARD everything here is empty.
+ */
+using ViolationHandler = void (*)(const char* operation);
+
+#ifdef REALTIME_GUARD
+/**
+ * @brief Mark or unmark the calling thread as real-time.
+ *
+ * @return whether the thread was marked before
+ */
+bool markRealTimeThread(bool isRealTime);
+/**
+ * @brief Replace the default handler which aborts. @c handler is called on
+ * the real-time thread, allocating or locking in it is not checked
+ */
+void setViolationHandler(ViolationHandler handler);
+#else
+inline bool markRealTimeThread(bool /*isRealTime*/) { return false; }
+inline void setViolationHandler(ViolationHandler /*handler*/) {}
+#endif
+
+/**
+ * @brief Marks the current thread as real-time while alive
+ */
+class RealTimeScope {
+  public:
+    RealTimeScope() : m_wasRealTime{markRealTimeThread(true)} {}
+    ~RealTimeScope() { markRealTimeThread(m_wasRealTime); }
+
+  private:
+    // noncopyable
+    RealTimeScope(const RealTimeScope&) = delete;
+    RealTimeScope& operator=(const RealTimeScope&) = delete;
+
+    const bool m_wasRealTime;
+};
+}  // namespace RealTime
+}  // namespace Utils
@@ -1,36 +1,152 @@
 #pragma once
 
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "AudioBackend.h"
 #include "AudioStream.h"
-#include "PortAudioWrapper.h"
+#include "SampleConverter.h"
 
 namespace Audio {
 
 namespace Recorder {
 class Recorder {
   public:
+    /**
+     * @brief Construct a new Recorder object capturing into an int16_t
+     * stream
+     *
+     * @param bitsPerSample bits of stream samples
+     * @param deviceFormat native format of capture device, converted to
+     * stream format in the capture callback
+     */
     Recorder(const int sampleRate,
              const int bitsPerSample,
              const int numChannels,
              std::unique_ptr<AudioInputStream::Writer> writer,
-             std::shared_ptr<PortAudio::PortAudioWrapper> portAudioWrapper);
+             std::shared_ptr<AudioBackend> audioBackend,
+             const SampleFormat deviceFormat = SampleFormat::INT16);
+    /**
+     * @brief Construct a new Recorder object capturing into a float stream,
+     * samples are in 16 bits range whatever @c deviceFormat is
+     *
+     * @param writer optional int16_t stream written with the same samples,
+     * for consumers which don't take float
+     */
+    Recorder(const int sampleRate,
+             const int bitsPerSample,
+             const int numChannels,
+             std::unique_ptr<AudioInputStream::Writer> writer,
+             std::unique_ptr<AudioInputFloatStream::Writer> floatWriter,
+             std::shared_ptr<AudioBackend> audioBackend,
+             const SampleFormat deviceFormat = SampleFormat::INT16);
+    /**
+     * @brief Construct a new Recorder object capturing a mic array, each
+     * channel into its own stream. Frames are deinterleaved in the capture
+     * callback, so per channel consumers can run on separate cores.
+     *
+     * @param channelWriters one writer per device channel
+     */
+    Recorder(const int sampleRate,
+             const int bitsPerSample,
+             std::vector<std::unique_ptr<AudioInputStream::Writer>>
+                 channelWriters,
+             std::shared_ptr<AudioBackend> audioBackend,
+             const SampleFormat deviceFormat = SampleFormat::INT16);
     ~Recorder();
     void startRecord();
     void stopRecord();
     bool isRecording() const;
+    /*
+     * Errors of the capture callback since the recorder is created, for
+     * monitoring. They are also logged periodically from a non real-time
+     * thread
+     */
+    uint64_t getNumFailedWrites() const;
+    uint64_t getNumDroppedSamples() const;
+    uint64_t getNumInputOverflows() const;
 
     const int m_sampleRate;
     const int m_bitsPerSample;
     const int m_numChannels;
+    const SampleFormat m_deviceFormat;
 
   private:
+    Recorder(const int sampleRate,
+             const int bitsPerSample,
+             const int numChannels,
+             std::unique_ptr<AudioInputStream::Writer> writer,
+             std::unique_ptr<AudioInputFloatStream::Writer> floatWriter,
+             std::vector<std::unique_ptr<AudioInputStream::Writer>>
+                 &&channelWriters,
+             std::shared_ptr<AudioBackend> audioBackend,
+             const SampleFormat deviceFormat);
     // noncopyable
     Recorder(const Recorder&) = delete;
     Recorder& operator=(const Recorder&) = delete;
 
-    std::shared_ptr<PortAudio::PortAudioWrapper> m_portAudioWrapper;
+    /*
+     * Capture callback, runs on the backend audio thread. Only copies data
+     * into the stream and counts errors, never allocates, locks or logs.
+     * Waits for readers of a BLOCK_WRITER stream only if the backend isn't
+     * real time
+     */
+    static void onAudioCaptured(const void* data,
+                                unsigned long numSamples,
+                                unsigned long statusFlags,
+                                void* userData);
+    /*
+     * Convert @c numSamples device samples in chunks of @c buffer size and
+     * write them, returns num of samples written before the stream was full
+     */
+    template <typename Writer, typename T>
+    size_t writeSamples(Writer& writer,
+                        std::vector<T>& buffer,
+                        const void* data,
+                        size_t numSamples);
+    // tryWrite, or write which waits for readers if the backend isn't real
+    // time
+    template <typename Writer, typename T>
+    size_t writeToStream(Writer& writer, const T* data, size_t numSamples);
+    /*
+     * Deinterleave @c numFrames device frames into channel streams, returns
+     * num of samples which didn't fit
+     */
+    size_t writeChannels(const void* data, size_t numFrames);
+    // writers of all streams, for open and close
+    template <typename Function>
+    void forEachWriter(Function function);
+    // drain error counters of the capture callback and log them
+    void errorReportLoop();
+
+    std::shared_ptr<AudioBackend> m_audioBackend;
+    // backend isn't driven by a device clock, see AudioBackend::isRealTime
+    const bool m_isBlockingWrite;
+    // writer, float writer or both, or channel writers
     std::unique_ptr<AudioInputStream::Writer> m_writer;
+    std::unique_ptr<AudioInputFloatStream::Writer> m_floatWriter;
+    std::vector<std::unique_ptr<AudioInputStream::Writer>> m_channelWriters;
+    SampleConverter m_converter;
+    // preallocated, the capture callback converts into one of them
+    std::vector<AudioInputStreamSize> m_conversionBuffer;
+    std::vector<AudioInputFloatStreamSize> m_floatConversionBuffer;
+    // one deinterleaved chunk per channel
+    std::vector<std::vector<AudioInputStreamSize>> m_channelBuffers;
+    std::vector<AudioInputStreamSize*> m_channelBufferPointers;
     std::atomic<bool> m_isReady;
     std::atomic<bool> m_isRecording;
+
+    // written by capture callback only
+    std::atomic<uint64_t> m_numFailedWrites;
+    std::atomic<uint64_t> m_numDroppedSamples;
+    std::atomic<uint64_t> m_numInputOverflows;
+
+    std::unique_ptr<std::thread> m_errorReportThread;
+    std::mutex m_errorReportMtx;
+    std::condition_variable m_cvErrorReport;
+    bool m_isErrorReportRunning;
 };
 }  // namespace Recorder
 }  // namespace Audio
\ No newline at end of file
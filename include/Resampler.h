@@ -0,0 +1,63 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace Audio {
+/**
+ * @brief Polyphase FIR resampler for any rational ratio of two rates, e.g.
+ * 48000 to 16000 or 44100 to 16000. Upsamples by L and downsamples by M
+ * without computing the samples which are thrown away, so each output sample
+ * costs one dot product of @c getNumTapsPerPhase taps, done with SIMD.
+ *
+ * The prototype low pass is a Kaiser windowed sinc, cut at 90% of the lower
+ * Nyquist rate with about 80 dB stop band attenuation. Mono only.
+ */
+class Resampler {
+  public:
+    /**
+     * @param maxInputNum max num of samples passed to @c process at once,
+     * buffers are allocated here so @c process never allocates
+     */
+    Resampler(int inputRate, int outputRate, size_t maxInputNum);
+
+    /**
+     * @brief Resample @c numInput samples, continuing from the previous call.
+     * @c output must hold @c getMaxOutputNum(numInput) samples.
+     *
+     * @return num of samples written into @c output
+     */
+    size_t process(const int16_t* input, size_t numInput, int16_t* output);
+
+    size_t getMaxOutputNum(size_t numInput) const;
+    size_t getNumTapsPerPhase() const;
+    /// Group delay of the filter in input samples
+    size_t getDelay() const;
+    /// Drop history, as if nothing was processed yet
+    void reset();
+
+    const int m_inputRate;
+    const int m_outputRate;
+
+  private:
+    // @c numInput is at most m_maxInputNum
+    size_t processChunk(const int16_t* input,
+                        size_t numInput,
+                        int16_t* output);
+
+    // upsampling and downsampling factors
+    size_t m_upFactor;
+    size_t m_downFactor;
+    size_t m_numTapsPerPhase;
+    size_t m_maxInputNum;
+    // m_upFactor phases of m_numTapsPerPhase taps, each reversed so it runs
+    // forward over input history
+    std::vector<float> m_coefficients;
+    // last m_numTapsPerPhase - 1 inputs followed by the new ones
+    std::vector<float> m_history;
+    size_t m_historyNum;
+    // position of next output in upsampled rate, from start of m_history
+    uint64_t m_time;
+};
+}  // namespace Audio
@@ -0,0 +1,157 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <thread>
+#include <vector>
+
+#include "BasicLogger.h"
+#include "Resampler.h"
+
+namespace Audio {
+/**
+ * @brief Thread which reads int16_t samples from one stream, resamples them
+ * and writes them into another stream, e.g. from device rate capture to the
+ * 16 kHz stream of detectors, or from the 16 kHz response to device rate
+ * playback. Time spent resampling is measured, see
+ * @c getCostPerOutputSample.
+ */
+template <typename InputStream, typename OutputStream>
+class ResamplerStage {
+  public:
+    ResamplerStage(std::shared_ptr<typename InputStream::Reader> reader,
+                   std::unique_ptr<typename OutputStream::Writer> writer,
+                   int inputRate,
+                   int outputRate);
+    ~ResamplerStage();
+
+    uint64_t getNumOutputSamples() const;
+    /// Average resampling time per output sample in ns
+    double getCostPerOutputSample() const;
+
+  private:
+    // noncopyable
+    ResamplerStage(const ResamplerStage&) = delete;
+    ResamplerStage& operator=(const ResamplerStage&) = delete;
+
+    void resampleLoop();
+
+    static constexpr const char* TAG = "ResamplerStage";
+    /// Max samples resampled at once
+    static constexpr size_t MAX_INPUT_NUM = 1024;
+    /// Wake up at least this often to check if the stage is still running
+    static constexpr std::chrono::milliseconds READ_TIMEOUT{100};
+
+    std::shared_ptr<typename InputStream::Reader> m_reader;
+    std::unique_ptr<typename OutputStream::Writer> m_writer;
+    Resampler m_resampler;
+    std::vector<int16_t> m_inputBuffer;
+    std::vector<int16_t> m_outputBuffer;
+
+    std::atomic<uint64_t> m_numOutputSamples;
+    std::atomic<uint64_t> m_resampleTimeNs;
+
+    std::atomic<bool> m_isRunning;
+    std::unique_ptr<std::thread> m_resampleThread;
+};
+
+template <typename InputStream, typename OutputStream>
+constexpr std::chrono::milliseconds
+    ResamplerStage<InputStream, OutputStream>::READ_TIMEOUT;
+
+template <typename InputStream, typename OutputStream>
+ResamplerStage<InputStream, OutputStream>::ResamplerStage(
+    std::shared_ptr<typename InputStream::Reader> reader,
+    std::unique_ptr<typename OutputStream::Writer> writer,
+    int inputRate,
+    int outputRate)
+    : m_reader{reader},
+      m_writer{std::move(writer)},
+      m_resampler{inputRate, outputRate, MAX_INPUT_NUM},
+      m_inputBuffer(MAX_INPUT_NUM),
+      m_outputBuffer(m_resampler.getMaxOutputNum(MAX_INPUT_NUM)),
+      m_numOutputSamples{0},
+      m_resampleTimeNs{0},
+      m_isRunning{true} {
+    m_resampleThread = std::make_unique<std::thread>(
+        &ResamplerStage<InputStream, OutputStream>::resampleLoop, this);
+}
+
+template <typename InputStream, typename OutputStream>
+ResamplerStage<InputStream, OutputStream>::~ResamplerStage() {
+    m_isRunning = false;
+    // wake up a write blocked by a full output stream
+    m_writer->close();
+    m_resampleThread->join();
+    Utils::Logger::BasicLogger::getInstance().log(
+        TAG, Utils::Logger::LogLevel::INFO,
+        std::to_string(m_resampler.m_inputRate) + " -> " +
+            std::to_string(m_resampler.m_outputRate) + " | resampled " +
+            std::to_string(getNumOutputSamples()) + " samples | " +
+            std::to_string(getCostPerOutputSample()) +
+            " ns per output sample");
+}
+
+template <typename InputStream, typename OutputStream>
+uint64_t ResamplerStage<InputStream, OutputStream>::getNumOutputSamples()
+    const {
+    return m_numOutputSamples.load(std::memory_order_relaxed);
+}
+
+template <typename InputStream, typename OutputStream>
+double ResamplerStage<InputStream, OutputStream>::getCostPerOutputSample()
+    const {
+    uint64_t numOutputSamples = getNumOutputSamples();
+    return numOutputSamples > 0
+               ? static_cast<double>(
+                     m_resampleTimeNs.load(std::memory_order_relaxed)) /
+                     numOutputSamples
+               : 0;
+}
+
+template <typename InputStream, typename OutputStream>
+void ResamplerStage<InputStream, OutputStream>::resampleLoop() {
+    using namespace Utils::Logger;
+    BasicLogger::getInstance().log(TAG, LogLevel::DEBUG,
+                                   "*** THREAD START ***");
+    bool isOutputClosed = false;
+    while (m_isRunning) {
+        size_t readNum = m_reader->waitRead(m_inputBuffer.data(), 1,
+                                            MAX_INPUT_NUM, READ_TIMEOUT);
+        if (readNum == 0) {
+            if (m_reader->isWriterClosed()) {
+                // end of input is the end of output too
+                if (!isOutputClosed) {
+                    m_writer->close();
+                    isOutputClosed = true;
+                }
+                std::this_thread::sleep_for(READ_TIMEOUT);
+            }
+            continue;
+        }
+        if (isOutputClosed && m_isRunning) {
+            // input writer is opened again
+            m_writer->open();
+            isOutputClosed = false;
+        }
+        auto startTime = std::chrono::steady_clock::now();
+        size_t outputNum = m_resampler.process(m_inputBuffer.data(), readNum,
+                                               m_outputBuffer.data());
+        m_resampleTimeNs.fetch_add(
+            std::chrono::duration_cast<std::chrono::nanoseconds>(
+                std::chrono::steady_clock::now() - startTime)
+                .count(),
+            std::memory_order_relaxed);
+        m_numOutputSamples.fetch_add(outputNum, std::memory_order_relaxed);
+
+        if (outputNum > 0 && m_isRunning &&
+            m_writer->write(m_outputBuffer.data(), outputNum) < outputNum) {
+            BasicLogger::getInstance().log(
+                TAG, LogLevel::WARNING,
+                "output stream is full, resampled samples are dropped");
+        }
+    }
+    BasicLogger::getInstance().log(TAG, LogLevel::DEBUG, "*** THREAD END ***");
+}
+}  // namespace Audio
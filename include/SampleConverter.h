@@ -0,0 +1,56 @@
+#pragma once
+
+#include <cstdint>
+
+#include "AudioBackend.h"
+
+namespace Audio {
+/**
+ * @brief Converts native device samples to stream samples. Streams hold
+ * int16_t, or float in the same 16 bits range, which is what snowboy's float
+ * RunDetection takes. Narrowing to int16_t adds TPDF dither and saturates.
+ *
+ * Kernels use NEON on ARM, AVX2 or SSE2 on x86, whichever the compiler
+ * targets, and plain C++ otherwise. Never allocates or locks, so it can run in
+ * audio callbacks.
+ */
+class SampleConverter {
+  public:
+    /**
+     * @param inputFormat native format of device
+     * @param shouldDither add dither when narrowing to int16_t
+     */
+    SampleConverter(SampleFormat inputFormat, bool shouldDither = true);
+
+    /**
+     * @brief Convert @c numSamples samples of input format, channels count as
+     * separate samples
+     */
+    void convert(const void* input, int16_t* output, size_t numSamples);
+    void convert(const void* input, float* output, size_t numSamples);
+
+    SampleFormat getInputFormat() const;
+
+  private:
+    template <typename T>
+    void convertTo(const void* input, T* output, size_t numSamples);
+
+    const SampleFormat m_inputFormat;
+    const bool m_shouldDither;
+    // one xorshift generator per SIMD lane. Loaded unaligned, heap objects
+    // are only 16 byte aligned before C++17
+    uint32_t m_ditherState[8];
+};
+
+/**
+ * @brief Split @c numFrames interleaved frames of @c numChannels channels
+ * into one buffer per channel. 2 and 4 channels use SIMD, NEON also does 3.
+ * Never allocates, so it can run in audio callbacks.
+ *
+ * @param outputs @c numChannels buffers of at least @c numFrames samples
+ */
+void deinterleave(const int16_t* input,
+                  size_t numChannels,
+                  size_t numFrames,
+                  int16_t* const* outputs);
+}  // namespace Audio
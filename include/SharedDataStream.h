@@ -1,63 +1,260 @@
 #pragma once
 
+#include <array>
 #include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <functional>
 #include <memory>
 #include <mutex>
-#include <unordered_set>
 #include <vector>
 
 #include "BasicLogger.h"
 #include "CircularBuffer.h"
+#include "Futex.h"
 
 using namespace Utils::Logger;
 
 namespace Utils {
 namespace DataStructures {
+/**
+ * What the writer does when the stream is full and the slowest reader hasn't
+ * read the oldest data yet
+ */
+enum class OverflowPolicy {
+    /// overwrite the oldest data, readers which are overrun count it and skip
+    /// to the oldest data still in the stream. Writer never blocks
+    DROP_OLDEST = 0,
+    /// writer sleeps until readers make room or the write timeout expired.
+    /// Only for streams whose writer is not real-time
+    BLOCK_WRITER
+};
+
 /**
  *Template class for SharedDataStream, which allowed several reader but only one
  *writer. Inside this class use a CircularBuffer to store data stream.
  *
+ *Writer and readers don't share any lock. Every element written into the
+ *stream gets a 64-bit sequence number which never wraps. The writer announces
+ *the range it is going to overwrite in @c m_reserveSequence, copies the data,
+ *then publishes it with a release store to @c m_writeSequence. Readers copy
+ *without lock and compare their own sequence with the two published ones to
+ *detect if the writer has overrun them, so the writer never blocks on a
+ *reader.
+ *
+ *Readers hold absolute stream positions, which are mapped to a slot of the
+ *CircularBuffer, so the writer doesn't need to know anything about readers and
+ *adding readers costs the writer nothing. Each reader owns one entry of a
+ *fixed registry while it is alive, registering and deregistering is a single
+ *CAS and never blocks the writer.
+ *
+ *Readers can sleep in @c Reader::waitRead until enough data is published. The
+ *writer only makes a futex wake syscall when there is someone waiting.
+ *
+ *With OverflowPolicy::BLOCK_WRITER the writer checks positions of all readers
+ *before writing and sleeps until the slowest one makes room, so no data is
+ *lost as long as readers keep up within the write timeout.
+ *
  * @tparam T Type of data which SharedDataStream stored.
+ * @tparam N Capacity fixed at compile time, must be a power of two. 0 means
+ * capacity is decided at run time.
  */
-template <typename T>
+template <typename T, size_t N = 0>
 class SharedDataStream {
   public:
     class Writer;
     class Reader;
 
-    SharedDataStream(size_t size);
+    /**
+     * @param size num of elements the stream keeps
+     * @param storage with CircularBufferStorage::MIRRORED every region returned
+     * by @c Reader::peek is continuous, size is rounded up to whole pages. Not
+     * supported if @c N is not 0
+     * @param overflowPolicy what writer does when stream is full
+     * @param writeTimeout max time @c Writer::write blocks with
+     * OverflowPolicy::BLOCK_WRITER
+     */
+    SharedDataStream(
+        size_t size,
+        CircularBufferStorage storage = CircularBufferStorage::HEAP,
+        OverflowPolicy overflowPolicy = OverflowPolicy::DROP_OLDEST,
+        std::chrono::milliseconds writeTimeout = DEFAULT_WRITE_TIMEOUT);
     ~SharedDataStream();
     std::unique_ptr<Writer> createWriter();
+    /*
+     * The reader is deregistered when the last handle is released. Readers
+     * must not outlive the stream.
+     * @return nullptr if there are already @c MAX_READERS readers
+     */
     std::shared_ptr<Reader> createReader();
+    /*
+     * Deregister @c reader before its handles are released. The writer stops
+     * waiting for it and it can't read anymore
+     */
+    void removeReader(std::shared_ptr<Reader> reader);
+    /*
+     * Total num of overruns of all readers, for monitoring
+     */
+    uint64_t getOverrunCount();
     std::atomic<bool> isReady;
 
+    static constexpr std::chrono::milliseconds DEFAULT_WRITE_TIMEOUT{1000};
+    static constexpr size_t MAX_READERS = 16;
+
   private:
+    /*
+     * Registry entry of a reader. Owned by one reader from createReader until
+     * it is destroyed, the writer only reads it
+     */
+    struct ReaderSlot {
+        std::atomic<bool> isUsed;
+        // cleared by removeReader, writer ignores unregistered readers
+        std::atomic<bool> isRegistered;
+        // cleared by Reader::setBlockingWriter, a blocked writer doesn't wait
+        // for the reader then
+        std::atomic<bool> isBlockingWriter;
+        // position of next element the reader is going to read
+        std::atomic<uint64_t> position;
+    };
+
     // noncopyable
     SharedDataStream(const SharedDataStream&) = delete;
     SharedDataStream& operator=(const SharedDataStream&) = delete;
 
-    std::shared_ptr<CircularBuffer<T>> m_circularBuffer;
-    std::mutex m_circularBufferMtx;
+    // sequence of the oldest element still stored in the stream
+    uint64_t oldestSequence(uint64_t writeSequence) const;
+    // wake up all readers sleeping in waitRead, cheap if nobody is waiting
+    void notifyReaders();
+    // num of elements writer can write without overrunning any reader
+    size_t getWritableNum(uint64_t writeSequence);
+    // wake up the writer blocked by a full stream, cheap if it isn't blocked
+    void notifyWriter();
+
+    CircularBuffer<T, N> m_circularBuffer;
+    const size_t m_capacity;
+    const OverflowPolicy m_overflowPolicy;
+    const std::chrono::milliseconds m_writeTimeout;
+    // end of the data region which is published to readers
+    std::atomic<uint64_t> m_writeSequence;
+    // end of the data region which writer is writing, always >= write sequence
+    std::atomic<uint64_t> m_reserveSequence;
     std::atomic<bool> m_isWriterCreated;
-    std::unordered_set<std::shared_ptr<Reader>> m_readers;
-    std::mutex m_writerReaderMtx;
+    // set when writer is closed, readers stop waiting for data
+    std::atomic<bool> m_isWriterClosed;
+    // futex word readers sleep on, bumped by writer on every notify
+    std::atomic<int> m_wakeCounter;
+    std::atomic<int> m_numWaitingReaders;
+    // futex word writer sleeps on when blocked, bumped by readers
+    std::atomic<int> m_writerWakeCounter;
+    std::atomic<bool> m_isWriterWaiting;
+    std::array<ReaderSlot, MAX_READERS> m_readerSlots;
+    // overruns of all readers since the stream is created
+    std::atomic<uint64_t> m_overrunCount;
+    std::mutex m_writerMtx;
 };
-template <typename T>
-SharedDataStream<T>::SharedDataStream(size_t size)
-    : isReady{false}, m_circularBuffer{nullptr}, m_isWriterCreated{false} {
-    m_circularBuffer = std::make_shared<CircularBuffer<T>>(size);
+
+template <typename T, size_t N>
+constexpr std::chrono::milliseconds
+    SharedDataStream<T, N>::DEFAULT_WRITE_TIMEOUT;
+
+template <typename T, size_t N>
+constexpr size_t SharedDataStream<T, N>::MAX_READERS;
+
+template <typename T, size_t N>
+SharedDataStream<T, N>::SharedDataStream(
+    size_t size,
+    CircularBufferStorage storage,
+    OverflowPolicy overflowPolicy,
+    std::chrono::milliseconds writeTimeout)
+    : isReady{false},
+      m_circularBuffer{size, storage},
+      m_capacity{m_circularBuffer.capacity()},
+      m_overflowPolicy{overflowPolicy},
+      m_writeTimeout{writeTimeout},
+      m_writeSequence{0},
+      m_reserveSequence{0},
+      m_isWriterCreated{false},
+      m_isWriterClosed{false},
+      m_wakeCounter{0},
+      m_numWaitingReaders{0},
+      m_writerWakeCounter{0},
+      m_isWriterWaiting{false},
+      m_overrunCount{0} {
+    for (auto& slot : m_readerSlots) {
+        slot.isUsed = false;
+        slot.isRegistered = false;
+        slot.isBlockingWriter = true;
+        slot.position = 0;
+    }
     isReady = true;
 }
 
-template <typename T>
-SharedDataStream<T>::~SharedDataStream() {
+template <typename T, size_t N>
+SharedDataStream<T, N>::~SharedDataStream() {
     isReady = false;
 }
 
-template <typename T>
-std::unique_ptr<typename SharedDataStream<T>::Writer>
-SharedDataStream<T>::createWriter() {
-    std::lock_guard<std::mutex> lock(m_writerReaderMtx);
+template <typename T, size_t N>
+uint64_t SharedDataStream<T, N>::oldestSequence(uint64_t writeSequence) const {
+    return writeSequence > m_capacity ? writeSequence - m_capacity : 0;
+}
+
+template <typename T, size_t N>
+void SharedDataStream<T, N>::notifyReaders() {
+    // pairs with the increment of m_numWaitingReaders in Reader::waitRead, so
+    // either the writer sees a waiting reader or the reader sees new data
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (m_numWaitingReaders.load(std::memory_order_relaxed) > 0) {
+        m_wakeCounter.fetch_add(1, std::memory_order_release);
+        Utils::Threading::futexWake(m_wakeCounter);
+    }
+}
+
+template <typename T, size_t N>
+size_t SharedDataStream<T, N>::getWritableNum(uint64_t writeSequence) {
+    uint64_t slowestPosition = writeSequence;
+    for (auto& slot : m_readerSlots) {
+        if (!slot.isRegistered.load(std::memory_order_acquire) ||
+            !slot.isBlockingWriter.load(std::memory_order_relaxed)) {
+            continue;
+        }
+        // pairs with the CAS after copying, so a blocked writer never
+        // overwrites data which is still being read
+        uint64_t position = slot.position.load(std::memory_order_acquire);
+        if (position < slowestPosition) {
+            slowestPosition = position;
+        }
+    }
+    // data before the oldest one is already gone, don't wait for it
+    uint64_t oldest = oldestSequence(writeSequence);
+    if (slowestPosition < oldest) {
+        slowestPosition = oldest;
+    }
+    return m_capacity - (writeSequence - slowestPosition);
+}
+
+template <typename T, size_t N>
+void SharedDataStream<T, N>::notifyWriter() {
+    if (m_overflowPolicy != OverflowPolicy::BLOCK_WRITER) {
+        return;
+    }
+    // pairs with the store of m_isWriterWaiting in Writer::write
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (m_isWriterWaiting.load(std::memory_order_relaxed)) {
+        m_writerWakeCounter.fetch_add(1, std::memory_order_release);
+        Utils::Threading::futexWake(m_writerWakeCounter);
+    }
+}
+
+template <typename T, size_t N>
+uint64_t SharedDataStream<T, N>::getOverrunCount() {
+    return m_overrunCount.load(std::memory_order_relaxed);
+}
+
+template <typename T, size_t N>
+std::unique_ptr<typename SharedDataStream<T, N>::Writer>
+SharedDataStream<T, N>::createWriter() {
+    std::lock_guard<std::mutex> lock(m_writerMtx);
     if (!m_isWriterCreated) {
         m_isWriterCreated = true;
         return std::unique_ptr<Writer>(new Writer(*this));
@@ -67,13 +264,38 @@ SharedDataStream<T>::createWriter() {
         return nullptr;
     }
 }
-template <typename T>
-std::shared_ptr<typename SharedDataStream<T>::Reader>
-SharedDataStream<T>::createReader() {
-    std::lock_guard<std::mutex> lock(m_writerReaderMtx);
-    auto newReader = std::make_shared<Reader>(*this);
-    m_readers.insert(newReader);
-    return newReader;
+template <typename T, size_t N>
+std::shared_ptr<typename SharedDataStream<T, N>::Reader>
+SharedDataStream<T, N>::createReader() {
+    for (auto& slot : m_readerSlots) {
+        bool isUsed = false;
+        if (!slot.isUsed.compare_exchange_strong(isUsed, true)) {
+            continue;
+        }
+        // start from the oldest data, data overwritten before the reader
+        // existed isn't an overrun
+        slot.position.store(
+            oldestSequence(m_writeSequence.load(std::memory_order_acquire)),
+            std::memory_order_relaxed);
+        slot.isBlockingWriter.store(true, std::memory_order_relaxed);
+        slot.isRegistered.store(true, std::memory_order_release);
+        return std::make_shared<Reader>(*this, slot);
+    }
+    BasicLogger::getInstance().log(typeid(*this).name(), LogLevel::ERROR,
+                                   "Too many readers");
+    return nullptr;
+}
+
+template <typename T, size_t N>
+void SharedDataStream<T, N>::removeReader(std::shared_ptr<Reader> reader) {
+    if (nullptr == reader || &reader->m_sharedDataStream != this) {
+        BasicLogger::getInstance().log(typeid(*this).name(), LogLevel::ERROR,
+                                       "removeReader: Invalid parameter");
+        return;
+    }
+    reader->m_slot.isRegistered.store(false, std::memory_order_release);
+    // writer may be waiting for this reader
+    notifyWriter();
 }
 
 }  // namespace DataStructures
@@ -5,9 +5,31 @@
 #include "PortAudioWrapper.h"
 #include "SnowBoyWrapper.h"
 
+#include <atomic>
+#include <chrono>
 #include <thread>
 
 namespace KeyWord {
+/*
+ *    Optional VAD gate in front of the hot word model. Without a resource
+ *    file the hot word model runs on every frame
+ */
+struct SnowBoyVadConfig {
+    std::string resourceFile;
+    // audio before speech onset which the hot word model still gets
+    std::chrono::milliseconds preRoll{500};
+    // silence after speech before the hot word model stops
+    std::chrono::milliseconds hangover{1000};
+};
+
+/*
+ *    Runs snowboy in its own thread. The thread sleeps until a whole frame of
+ *    audio is in the stream, then feeds snowboy constant size frames, so CPU
+ *    load is even and a keyword is found at most one frame after it is spoken.
+ *    With a VAD gate, the cheap VAD runs on every frame and the hot word model
+ *    only while there is speech, starting from the pre-roll before the onset,
+ *    which is still in the stream
+ */
 class SnowBoyKeyWordDetector : public KeyWordDetector {
   public:
     // config struct for different model
@@ -15,24 +37,146 @@ class SnowBoyKeyWordDetector : public KeyWordDetector {
         std::string modelFiles;
         std::string keyWords;
         std::string sensitivity;
+        // how long after the end of keyword the model fires, reported
+        // positions are moved back by it
+        std::chrono::milliseconds latencyCompensation{0};
     };
     SnowBoyKeyWordDetector(
         std::shared_ptr<Audio::AudioInputStream::Reader> reader,
         const std::vector<SnowBoyModelConfig> configs,
         const std::string& resourceFile,
         const float audioGain,
-        const bool applyFrontEnd);
+        const bool applyFrontEnd,
+        const std::chrono::milliseconds frameDuration =
+            std::chrono::milliseconds(10),
+        const SnowBoyVadConfig& vadConfig = SnowBoyVadConfig());
+    /*
+     * Feeds snowboy float samples in 16 bits range, as written by a Recorder
+     * into an AudioInputFloatStream, without converting them back to int16_t.
+     * The VAD only takes int16_t, frames are converted for it
+     */
+    SnowBoyKeyWordDetector(
+        std::shared_ptr<Audio::AudioInputFloatStream::Reader> reader,
+        const std::vector<SnowBoyModelConfig> configs,
+        const std::string& resourceFile,
+        const float audioGain,
+        const bool applyFrontEnd,
+        const std::chrono::milliseconds frameDuration =
+            std::chrono::milliseconds(10),
+        const SnowBoyVadConfig& vadConfig = SnowBoyVadConfig());
     ~SnowBoyKeyWordDetector();
 
+    /*
+     * Time from the last sample of a keyword arriving in the stream to
+     * the notification being dispatched, averaged over all detections.
+     * Arrival time is estimated from when the detector woke up and how far
+     * behind it was. Time until observers run is in @c getEventDispatcher
+     */
+    std::chrono::microseconds getAverageDetectionLatency() const;
+    std::chrono::microseconds getMaxDetectionLatency() const;
+    uint64_t getNumDetections() const;
+    /*
+     * Num of frames of audio, and how many of them the hot word model ran on.
+     * Pre-roll replayed after speech onset is counted again in both
+     */
+    uint64_t getNumFrames() const;
+    uint64_t getNumHotWordFrames() const;
+    /*
+     * Num of samples of the stream the detector is done with. Pre-roll isn't
+     * counted again, audio lost by overruns isn't counted
+     */
+    uint64_t getNumProcessedSamples() const;
+    /*
+     * CPU time the VAD gate saved, hot word model time of the skipped frames
+     * minus time spent in VAD. Estimated from average cost per frame
+     */
+    std::chrono::microseconds getSavedCpuTime() const;
+
   private:
+    SnowBoyKeyWordDetector(
+        std::shared_ptr<Audio::AudioInputStream::Reader> reader,
+        std::shared_ptr<Audio::AudioInputFloatStream::Reader> floatReader,
+        const std::vector<SnowBoyModelConfig>& configs,
+        const std::string& resourceFile,
+        const float audioGain,
+        const bool applyFrontEnd,
+        const std::chrono::milliseconds frameDuration,
+        const SnowBoyVadConfig& vadConfig);
+
+    // only one of the readers is set
     std::shared_ptr<Audio::AudioInputStream::Reader> m_reader;
+    std::shared_ptr<Audio::AudioInputFloatStream::Reader> m_floatReader;
     std::unique_ptr<std::thread> m_detectionThread;
     std::unique_ptr<SnowBoyWrapper> m_snowBoyEngine;
+    // null if VAD gate is disabled
+    std::unique_ptr<SnowBoyVadWrapper> m_vad;
 
     std::vector<std::string> m_keyWords;
+    // latency compensation of each keyword in samples
+    std::vector<uint64_t> m_keyWordCompensations;
+
+    // num of samples fed to snowboy at once
+    size_t m_frameSize;
+    // holds a frame which is split by the wrap point of a stream which isn't
+    // mirrored
+    std::vector<int16_t> m_frameBuffer;
+    std::vector<float> m_floatFrameBuffer;
+    // float frame converted for the VAD
+    std::vector<int16_t> m_vadBuffer;
+
+    std::atomic<uint64_t> m_numDetections;
+    std::atomic<uint64_t> m_totalLatencyUs;
+    std::atomic<uint64_t> m_maxLatencyUs;
+
+    size_t m_preRollSize;
+    size_t m_hangoverSize;
+    KeyWordObserverInterface::VoiceActivityState m_voiceActivityState;
+    // end of audio the VAD has seen, frames before it are pre-roll replayed
+    uint64_t m_vadPosition;
+    // end of last audio the VAD found speech in
+    uint64_t m_lastSpeechPosition;
+    // end of last audio the hot word model has seen
+    uint64_t m_hotWordPosition;
+    // end of audio the detector is done with
+    uint64_t m_processedPosition;
+
+    std::atomic<uint64_t> m_numFrames;
+    std::atomic<uint64_t> m_numHotWordFrames;
+    std::atomic<uint64_t> m_vadTimeNs;
+    std::atomic<uint64_t> m_hotWordTimeNs;
+    std::atomic<uint64_t> m_numProcessedSamples;
 
     std::atomic<bool> m_isRunning;
 
     void detectionThreadLoop();
+    // runs until stopped on the reader which is set
+    template <typename Reader, typename T>
+    void detectionLoop(Reader& reader, std::vector<T>& frameBuffer);
+    /*
+     * Peek at most @c frameSize samples as one continuous frame, copy it into
+     * @c frameBuffer if it is split by the wrap point. @c peekedNum is 0 if
+     * nothing is there, @c position is where the frame starts, after any
+     * overrun audio skipped
+     */
+    template <typename Reader, typename T>
+    const T* peekFrame(Reader& reader,
+                       std::vector<T>& frameBuffer,
+                       size_t frameSize,
+                       size_t& peekedNum,
+                       uint64_t& position);
+    /*
+     * Run VAD on the part of frame at @c position it hasn't seen.
+     * @return true if speech starts in this frame
+     */
+    bool updateVoiceActivity(const int16_t* frame,
+                             size_t frameSize,
+                             uint64_t position);
+    bool updateVoiceActivity(const float* frame,
+                             size_t frameSize,
+                             uint64_t position);
+    // move @c reader back to pre-roll before the frame at @c position
+    template <typename Reader>
+    void rewindToPreRoll(Reader& reader, uint64_t position);
+    void recordLatency(std::chrono::steady_clock::duration latency);
 };
 }  // namespace KeyWord
\ No newline at end of file
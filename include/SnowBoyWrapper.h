@@ -19,8 +19,30 @@ class SnowBoyWrapper {
     void SetSensitivity(const char* sensitivity_str);
 
     int RunDetection(const int16_t* data, int num_samples);
+    // samples in 16 bits range, e.g. from AudioInputFloatStream
+    int RunDetection(const float* data, int num_samples);
+    // drop audio context, e.g. when audio skips a gap
+    void Reset();
 
   private:
     std::unique_ptr<snowboy::SnowboyDetect> m_detector;
 };
+
+class SnowBoyVadWrapper {
+  public:
+    explicit SnowBoyVadWrapper(const char* resource_name);
+    ~SnowBoyVadWrapper();
+
+    int SampleRate() const;
+
+    void SetAudioGain(const float audio_gain);
+    void ApplyFrontend(const bool apply_frontend);
+
+    // -2 for silence, 0 for speech, -1 if an error occurred
+    int RunVad(const int16_t* data, int num_samples);
+    void Reset();
+
+  private:
+    std::unique_ptr<snowboy::SnowboyVad> m_vad;
+};
 }  // namespace KeyWord
\ No newline at end of file
@@ -3,9 +3,11 @@
 #include <mutex>
 #include <unordered_set>
 
+#include "EventDispatcher.h"
 #include "VoiceAssistantObserverInterface.h"
 /*
- *    Abstract class for VoiceAssistant, using observer pattern
+ *    Abstract class for VoiceAssistant, using observer pattern. Observers are
+ *    called on a dispatcher thread, the assistant never waits for them
  */
 
 namespace VoiceAssistantService {
@@ -20,6 +22,12 @@ class VoiceAssistant {
 
     virtual ~VoiceAssistant() = default;
 
+    /*
+     * Dispatcher of notifications, to measure how long they wait for
+     * observers
+     */
+    const Utils::Threading::EventDispatcher& getEventDispatcher() const;
+
   protected:
     VoiceAssistant();
     void notifyVoiceAssistantObservers(
@@ -29,5 +37,7 @@ class VoiceAssistant {
     std::unordered_set<std::shared_ptr<VoiceAssistantObserverInterface>>
         m_VoiceAssistantObservers;
     mutable std::mutex m_VoiceAssistantObserversMtx;
+    // destroyed first, runs notifications left while observers still exist
+    std::unique_ptr<Utils::Threading::EventDispatcher> m_eventDispatcher;
 };
 }  // namespace VoiceAssistantService
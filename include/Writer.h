@@ -9,10 +9,10 @@ using namespace Utils::Logger;
 
 namespace Utils {
 namespace DataStructures {
-template <typename T>
-class SharedDataStream<T>::Writer {
+template <typename T, size_t N>
+class SharedDataStream<T, N>::Writer {
   public:
-    Writer(SharedDataStream<T>& sharedDataStream);
+    Writer(SharedDataStream<T, N>& sharedDataStream);
     ~Writer();
     /**
      * This function adds new data to the stream by copying it from the
@@ -22,11 +22,30 @@ class SharedDataStream<T>::Writer {
      * @param nWrite The maximum number of @c wordSize words to copy.
      * @return The number of @c wordSize words copied, or zero if the
      * stream has closed.
+     *
+     * With OverflowPolicy::DROP_OLDEST this function never takes a lock,
+     * readers which are too slow will be overrun, and @c nWrite can't be more
+     * than the stream capacity.
+     *
+     * With OverflowPolicy::BLOCK_WRITER data is written in chunks as readers
+     * make room. If the write timeout of the stream expired, returns the num
+     * which is already written.
      */
     size_t write(const T* buf, size_t nWrite);
+    /**
+     * Real-time safe version of @c write for audio callbacks. Never blocks,
+     * allocates or logs, failures are only reported by the return value.
+     *
+     * With OverflowPolicy::BLOCK_WRITER only writes what fits without
+     * overrunning readers.
+     *
+     * @return The number of @c wordSize words copied, zero if nothing could
+     * be written.
+     */
+    size_t tryWrite(const T* buf, size_t nWrite);
     /**
      * Close the @c writer. After calling this function, @c write will
-     * return 0
+     * return 0, and readers waiting in @c waitRead are woken up
      */
     void close();
     /**
@@ -36,33 +55,37 @@ class SharedDataStream<T>::Writer {
     void open();
 
   private:
+    // copy data into the stream and publish it to readers
+    void publish(const T* buf, size_t nWrite);
+    // sleep until readers make room or @c deadline
+    void waitForReaders(std::chrono::steady_clock::time_point deadline);
+
     // noncopyable
     Writer(const Writer&) = delete;
     Writer& operator=(const Writer&) = delete;
-    void tell(size_t nDeleted);
 
     std::atomic<bool> m_isRunning;
-    SharedDataStream<T>& m_sharedDataStream;
+    SharedDataStream<T, N>& m_sharedDataStream;
 };
 
-template <typename T>
-SharedDataStream<T>::Writer::Writer(SharedDataStream<T>& sharedDataStream)
+template <typename T, size_t N>
+SharedDataStream<T, N>::Writer::Writer(SharedDataStream<T, N>& sharedDataStream)
     : m_isRunning{false}, m_sharedDataStream{sharedDataStream} {
     BasicLogger::getInstance().log(typeid(*this).name(), LogLevel::DEBUG,
                                    "Constructor called");
     open();
 }
 
-template <typename T>
-SharedDataStream<T>::Writer::~Writer() {
-    m_isRunning = false;
+template <typename T, size_t N>
+SharedDataStream<T, N>::Writer::~Writer() {
+    close();
     m_sharedDataStream.m_isWriterCreated = false;
     BasicLogger::getInstance().log(typeid(*this).name(), LogLevel::DEBUG,
                                    "Destructor called");
 }
 
-template <typename T>
-size_t SharedDataStream<T>::Writer::write(const T* buf, size_t nWrite) {
+template <typename T, size_t N>
+size_t SharedDataStream<T, N>::Writer::write(const T* buf, size_t nWrite) {
     if (!m_isRunning) {
         BasicLogger::getInstance().log(typeid(*this).name(), LogLevel::WARNING,
                                        "Writer is closed");
@@ -89,28 +112,118 @@ size_t SharedDataStream<T>::Writer::write(const T* buf, size_t nWrite) {
         return 0;
     }
 
-    std::lock_guard<std::mutex> lock(m_sharedDataStream.m_circularBufferMtx);
-    size_t nDeleted;
-    m_sharedDataStream.m_circularBuffer->pushRegion(buf, nWrite, nDeleted);
-    tell(nDeleted);
+    if (m_sharedDataStream.m_overflowPolicy == OverflowPolicy::BLOCK_WRITER) {
+        auto deadline =
+            std::chrono::steady_clock::now() + m_sharedDataStream.m_writeTimeout;
+        size_t nWritten = 0;
+        while (nWritten < nWrite && m_isRunning) {
+            // only one writer, so relaxed load of our own sequence is enough
+            size_t writableNum = m_sharedDataStream.getWritableNum(
+                m_sharedDataStream.m_writeSequence.load(
+                    std::memory_order_relaxed));
+            if (writableNum == 0) {
+                if (std::chrono::steady_clock::now() >= deadline) {
+                    BasicLogger::getInstance().log(
+                        typeid(*this).name(), LogLevel::WARNING,
+                        "write: timeout waiting for readers");
+                    break;
+                }
+                waitForReaders(deadline);
+                continue;
+            }
+            size_t num = nWrite - nWritten;
+            if (num > writableNum) {
+                num = writableNum;
+            }
+            publish(buf + nWritten, num);
+            nWritten += num;
+        }
+        return nWritten;
+    }
+
+    if (nWrite > m_sharedDataStream.m_capacity) {
+        BasicLogger::getInstance().log(typeid(*this).name(), LogLevel::ERROR,
+                                       "write: required write num is too much");
+        return 0;
+    }
+
+    publish(buf, nWrite);
     return nWrite;
 }
 
-template <typename T>
-void SharedDataStream<T>::Writer::close() {
-    m_isRunning = false;
+template <typename T, size_t N>
+size_t SharedDataStream<T, N>::Writer::tryWrite(const T* buf, size_t nWrite) {
+    if (!m_isRunning || !m_sharedDataStream.isReady || nullptr == buf ||
+        nWrite == 0) {
+        return 0;
+    }
+
+    size_t num = nWrite;
+    if (m_sharedDataStream.m_overflowPolicy == OverflowPolicy::BLOCK_WRITER) {
+        size_t writableNum = m_sharedDataStream.getWritableNum(
+            m_sharedDataStream.m_writeSequence.load(std::memory_order_relaxed));
+        if (num > writableNum) {
+            num = writableNum;
+        }
+    } else if (num > m_sharedDataStream.m_capacity) {
+        return 0;
+    }
+    if (num > 0) {
+        publish(buf, num);
+    }
+    return num;
 }
 
-template <typename T>
-void SharedDataStream<T>::Writer::open() {
-    m_isRunning = true;
+template <typename T, size_t N>
+void SharedDataStream<T, N>::Writer::publish(const T* buf, size_t nWrite) {
+    // only one writer, so relaxed load of our own sequence is enough
+    uint64_t writeSequence =
+        m_sharedDataStream.m_writeSequence.load(std::memory_order_relaxed);
+    // announce the region which is going to be overwritten before touching
+    // the buffer, readers check it after copy to detect torn data
+    m_sharedDataStream.m_reserveSequence.store(writeSequence + nWrite,
+                                               std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    m_sharedDataStream.m_circularBuffer.pushRegion(buf, nWrite);
+    // publish
+    m_sharedDataStream.m_writeSequence.store(writeSequence + nWrite,
+                                             std::memory_order_release);
+    m_sharedDataStream.notifyReaders();
 }
 
-template <typename T>
-void SharedDataStream<T>::Writer::tell(size_t nDeleted) {
-    for (auto reader : m_sharedDataStream.m_readers) {
-        reader->updateIndex(nDeleted);
+template <typename T, size_t N>
+void SharedDataStream<T, N>::Writer::waitForReaders(
+    std::chrono::steady_clock::time_point deadline) {
+    m_sharedDataStream.m_isWriterWaiting.store(true);
+    // pairs with the fence in notifyWriter, so either the reader sees the
+    // writer waiting or the writer sees the new reader position
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    int wakeCounter = m_sharedDataStream.m_writerWakeCounter.load(
+        std::memory_order_acquire);
+    uint64_t writeSequence =
+        m_sharedDataStream.m_writeSequence.load(std::memory_order_relaxed);
+    if (m_sharedDataStream.getWritableNum(writeSequence) == 0 && m_isRunning) {
+        Utils::Threading::futexWait(m_sharedDataStream.m_writerWakeCounter,
+                                    wakeCounter,
+                                    deadline - std::chrono::steady_clock::now());
     }
+    m_sharedDataStream.m_isWriterWaiting.store(false);
+}
+
+template <typename T, size_t N>
+void SharedDataStream<T, N>::Writer::close() {
+    m_isRunning = false;
+    m_sharedDataStream.m_isWriterClosed = true;
+    m_sharedDataStream.notifyReaders();
+    // let a write blocked by readers return
+    m_sharedDataStream.m_writerWakeCounter.fetch_add(1);
+    Utils::Threading::futexWake(m_sharedDataStream.m_writerWakeCounter);
+}
+
+template <typename T, size_t N>
+void SharedDataStream<T, N>::Writer::open() {
+    m_sharedDataStream.m_isWriterClosed = false;
+    m_isRunning = true;
 }
 
 }  // namespace DataStructures
@@ -0,0 +1,378 @@
+#include "AlsaMmapBackend.h"
+#include "BaseException.h"
+#include "BasicLogger.h"
+#include "RealTimeGuard.h"
+
+#include <pthread.h>
+#include <sched.h>
+
+using namespace Utils::Logger;
+using BaseClass::BaseException;
+
+namespace Audio {
+namespace Alsa {
+
+static const std::string TAG = "AlsaMmapBackend";
+
+/// Default period is 10 ms
+static const unsigned int DEFAULT_PERIODS_PER_SECOND = 100;
+/// Periods in the device ring buffer
+static const unsigned int NUM_PERIODS = 4;
+/// Wake up at least this often to check if the stream is stopped
+static const int WAIT_TIMEOUT_MS = 100;
+/// SCHED_FIFO priority of stream threads
+static const int THREAD_PRIORITY = 70;
+
+static snd_pcm_format_t toAlsaFormat(SampleFormat format) {
+    switch (format) {
+        case SampleFormat::INT24:
+            return SND_PCM_FORMAT_S24_3LE;
+        case SampleFormat::INT32:
+            return SND_PCM_FORMAT_S32_LE;
+        case SampleFormat::FLOAT32:
+            return SND_PCM_FORMAT_FLOAT_LE;
+        default:
+            return SND_PCM_FORMAT_S16_LE;
+    }
+}
+
+static void throwOnError(int err, const std::string& what) {
+    if (err < 0) {
+        std::string errorMsg = what + ". " + snd_strerror(err);
+        BasicLogger::getInstance().log(TAG, LogLevel::ERROR, errorMsg);
+
+        throw BaseException(errorMsg);
+    }
+}
+
+// called on stream thread before it turns real-time
+static void raiseThreadPriority() {
+    struct sched_param param;
+    param.sched_priority = THREAD_PRIORITY;
+    int err = pthread_setschedparam(pthread_self(), SCHED_FIFO, &param);
+    if (err != 0) {
+        BasicLogger::getInstance().log(
+            TAG, LogLevel::WARNING,
+            "Failed to set SCHED_FIFO, running with normal priority");
+    }
+}
+
+AlsaMmapBackend::AlsaMmapBackend(const std::string& captureDevice,
+                                 const std::string& playbackDevice)
+    : m_captureDevice{captureDevice}, m_playbackDevice{playbackDevice} {}
+
+AlsaMmapBackend::~AlsaMmapBackend() {
+    closeStream(m_captureStream);
+    closeStream(m_playbackStream);
+}
+
+void AlsaMmapBackend::addStream(const AudioBackendConfig& config) {
+    BasicLogger::getInstance().log(
+        TAG, LogLevel::DEBUG,
+        std::string("Adding ALSA mmap stream") + " | IOType " +
+            std::to_string(
+                static_cast<std::underlying_type<IOType>::type>(config.type)) +
+            " | sample rate " + std::to_string(config.sampleRate) +
+            " | sample size " + std::to_string(config.bitsPerSample) +
+            " | number of channels " + std::to_string(config.numChannels));
+
+    std::lock_guard<std::mutex> lock(m_alsaMtx);
+    switch (config.type) {
+        case IOType::INPUT:
+            openStream(m_captureStream, m_captureDevice, config);
+            break;
+        case IOType::OUTPUT:
+            openStream(m_playbackStream, m_playbackDevice, config);
+            break;
+        default:
+            std::string errorMsg = "Failed to add stream. Invalid IOType";
+            BasicLogger::getInstance().log(TAG, LogLevel::ERROR, errorMsg);
+
+            throw BaseException(errorMsg);
+    }
+}
+
+void AlsaMmapBackend::openStream(Stream& stream,
+                                 const std::string& device,
+                                 const AudioBackendConfig& config) {
+    if (stream.pcm != nullptr) {
+        std::string errorMsg = "Failed to add stream. Stream already added";
+        BasicLogger::getInstance().log(TAG, LogLevel::ERROR, errorMsg);
+
+        throw BaseException(errorMsg);
+    }
+    bool isCapture = config.type == IOType::INPUT;
+    snd_pcm_t* pcm = nullptr;
+    throwOnError(
+        snd_pcm_open(&pcm, device.c_str(),
+                     isCapture ? SND_PCM_STREAM_CAPTURE
+                               : SND_PCM_STREAM_PLAYBACK,
+                     0),
+        "Failed to open " + device);
+
+    try {
+        snd_pcm_hw_params_t* hwParams;
+        snd_pcm_hw_params_alloca(&hwParams);
+        throwOnError(snd_pcm_hw_params_any(pcm, hwParams),
+                     "Failed to get hw params");
+        throwOnError(snd_pcm_hw_params_set_access(
+                         pcm, hwParams, SND_PCM_ACCESS_MMAP_INTERLEAVED),
+                     "Device doesn't support mmap interleaved access");
+        throwOnError(
+            snd_pcm_hw_params_set_format(pcm, hwParams,
+                                         toAlsaFormat(config.sampleFormat)),
+            "Failed to set format");
+        throwOnError(
+            snd_pcm_hw_params_set_channels(pcm, hwParams, config.numChannels),
+            "Failed to set channels");
+        unsigned int rate = config.sampleRate;
+        throwOnError(
+            snd_pcm_hw_params_set_rate_near(pcm, hwParams, &rate, nullptr),
+            "Failed to set sample rate");
+        if (rate != static_cast<unsigned int>(config.sampleRate)) {
+            throwOnError(-EINVAL, "Sample rate " +
+                                      std::to_string(config.sampleRate) +
+                                      " is not supported");
+        }
+        snd_pcm_uframes_t periodSize =
+            config.framesPerBuffer > 0 ? config.framesPerBuffer
+                                       : rate / DEFAULT_PERIODS_PER_SECOND;
+        throwOnError(snd_pcm_hw_params_set_period_size_near(
+                         pcm, hwParams, &periodSize, nullptr),
+                     "Failed to set period size");
+        snd_pcm_uframes_t bufferSize = periodSize * NUM_PERIODS;
+        throwOnError(snd_pcm_hw_params_set_buffer_size_near(pcm, hwParams,
+                                                            &bufferSize),
+                     "Failed to set buffer size");
+        throwOnError(snd_pcm_hw_params(pcm, hwParams),
+                     "Failed to apply hw params");
+
+        snd_pcm_sw_params_t* swParams;
+        snd_pcm_sw_params_alloca(&swParams);
+        throwOnError(snd_pcm_sw_params_current(pcm, swParams),
+                     "Failed to get sw params");
+        throwOnError(snd_pcm_sw_params_set_avail_min(pcm, swParams, periodSize),
+                     "Failed to set avail min");
+        // playback starts once the whole buffer is filled, capture is
+        // started explicitly by startStream
+        throwOnError(
+            snd_pcm_sw_params_set_start_threshold(pcm, swParams, bufferSize),
+            "Failed to set start threshold");
+        throwOnError(snd_pcm_sw_params(pcm, swParams),
+                     "Failed to apply sw params");
+
+        stream.periodSize = periodSize;
+        BasicLogger::getInstance().log(
+            TAG, LogLevel::INFO,
+            device + " opened | period " + std::to_string(periodSize) +
+                " frames | buffer " + std::to_string(bufferSize) + " frames");
+    } catch (BaseException& e) {
+        snd_pcm_close(pcm);
+        throw;
+    }
+    stream.pcm = pcm;
+    stream.config = config;
+}
+
+void AlsaMmapBackend::closeStream(Stream& stream) {
+    stream.isRunning = false;
+    if (stream.thread) {
+        stream.thread->join();
+        stream.thread.reset();
+    }
+    if (stream.pcm != nullptr) {
+        snd_pcm_drop(stream.pcm);
+        snd_pcm_close(stream.pcm);
+        stream.pcm = nullptr;
+    }
+}
+
+void AlsaMmapBackend::startStream(const IOType& type) {
+    std::lock_guard<std::mutex> lock(m_alsaMtx);
+    Stream* stream = getStream(type);
+    if (stream == nullptr || stream->pcm == nullptr) {
+        std::string errorMsg = "Failed to start stream. Invalid IOType";
+        BasicLogger::getInstance().log(TAG, LogLevel::ERROR, errorMsg);
+
+        throw BaseException(errorMsg);
+    }
+    if (stream->isRunning) {
+        return;
+    }
+    // thread of a stream which failed to recover has ended by itself
+    if (stream->thread) {
+        stream->thread->join();
+        stream->thread.reset();
+    }
+
+    throwOnError(snd_pcm_prepare(stream->pcm), "Failed to prepare stream");
+    if (type == IOType::INPUT) {
+        throwOnError(snd_pcm_start(stream->pcm), "Failed to start stream");
+    }
+    stream->isRunning = true;
+    if (type == IOType::INPUT) {
+        stream->thread = std::make_unique<std::thread>(
+            &AlsaMmapBackend::captureLoop, this, std::ref(*stream));
+    } else {
+        stream->thread = std::make_unique<std::thread>(
+            &AlsaMmapBackend::playbackLoop, this, std::ref(*stream));
+    }
+}
+
+void AlsaMmapBackend::stopStream(const IOType& type) {
+    std::lock_guard<std::mutex> lock(m_alsaMtx);
+    Stream* stream = getStream(type);
+    if (stream == nullptr) {
+        std::string errorMsg = "Failed to stop stream. Invalid IOType";
+        BasicLogger::getInstance().log(TAG, LogLevel::ERROR, errorMsg);
+
+        throw BaseException(errorMsg);
+    }
+    stream->isRunning = false;
+    if (stream->thread) {
+        stream->thread->join();
+        stream->thread.reset();
+    }
+    if (stream->pcm != nullptr) {
+        snd_pcm_drop(stream->pcm);
+    }
+}
+
+AlsaMmapBackend::Stream* AlsaMmapBackend::getStream(const IOType& type) {
+    switch (type) {
+        case IOType::INPUT:
+            return &m_captureStream;
+        case IOType::OUTPUT:
+            return &m_playbackStream;
+        default:
+            return nullptr;
+    }
+}
+
+void AlsaMmapBackend::captureLoop(Stream& stream) {
+    BasicLogger::getInstance().log(TAG, LogLevel::DEBUG,
+                                   "*** CAPTURE THREAD START ***");
+    raiseThreadPriority();
+    {
+        unsigned long statusFlags = 0;
+        while (stream.isRunning) {
+            snd_pcm_sframes_t avail = snd_pcm_avail_update(stream.pcm);
+            if (avail < 0) {
+                // overrun, samples are lost
+                statusFlags |= AUDIO_INPUT_OVERFLOW;
+                if (snd_pcm_recover(stream.pcm, avail, 1) < 0 ||
+                    snd_pcm_start(stream.pcm) < 0) {
+                    break;
+                }
+                continue;
+            }
+            if (static_cast<snd_pcm_uframes_t>(avail) < stream.periodSize) {
+                snd_pcm_wait(stream.pcm, WAIT_TIMEOUT_MS);
+                continue;
+            }
+
+            const snd_pcm_channel_area_t* areas;
+            snd_pcm_uframes_t offset;
+            snd_pcm_uframes_t frames = stream.periodSize;
+            int err = snd_pcm_mmap_begin(stream.pcm, &areas, &offset, &frames);
+            if (err < 0) {
+                statusFlags |= AUDIO_INPUT_OVERFLOW;
+                snd_pcm_recover(stream.pcm, err, 1);
+                snd_pcm_start(stream.pcm);
+                continue;
+            }
+            // interleaved, all channels share the first area
+            const char* data = static_cast<const char*>(areas[0].addr) +
+                               (areas[0].first + offset * areas[0].step) / 8;
+            {
+                // catches allocation and locking in debug build
+                Utils::RealTime::RealTimeScope realTimeScope;
+                stream.config.inputCallback(data, frames, statusFlags,
+                                            stream.config.userData);
+            }
+            statusFlags = 0;
+
+            snd_pcm_sframes_t committed =
+                snd_pcm_mmap_commit(stream.pcm, offset, frames);
+            if (committed < 0 ||
+                static_cast<snd_pcm_uframes_t>(committed) != frames) {
+                statusFlags |= AUDIO_INPUT_OVERFLOW;
+                snd_pcm_recover(stream.pcm, committed < 0 ? committed : -EPIPE,
+                                1);
+                snd_pcm_start(stream.pcm);
+            }
+        }
+    }
+    // left by a failed recovery, not by stopStream. The stream has to be
+    // startable again, the thread is joined there
+    if (stream.isRunning.exchange(false)) {
+        BasicLogger::getInstance().log(TAG, LogLevel::ERROR,
+                                       "Failed to recover capture stream");
+    }
+    BasicLogger::getInstance().log(TAG, LogLevel::DEBUG,
+                                   "*** CAPTURE THREAD END ***");
+}
+
+void AlsaMmapBackend::playbackLoop(Stream& stream) {
+    BasicLogger::getInstance().log(TAG, LogLevel::DEBUG,
+                                   "*** PLAYBACK THREAD START ***");
+    raiseThreadPriority();
+    {
+        unsigned long statusFlags = 0;
+        while (stream.isRunning) {
+            snd_pcm_sframes_t avail = snd_pcm_avail_update(stream.pcm);
+            if (avail < 0) {
+                // underrun, device played silence or garbage
+                statusFlags |= AUDIO_OUTPUT_UNDERFLOW;
+                if (snd_pcm_recover(stream.pcm, avail, 1) < 0) {
+                    break;
+                }
+                continue;
+            }
+            if (static_cast<snd_pcm_uframes_t>(avail) < stream.periodSize) {
+                snd_pcm_wait(stream.pcm, WAIT_TIMEOUT_MS);
+                continue;
+            }
+
+            const snd_pcm_channel_area_t* areas;
+            snd_pcm_uframes_t offset;
+            snd_pcm_uframes_t frames = stream.periodSize;
+            int err = snd_pcm_mmap_begin(stream.pcm, &areas, &offset, &frames);
+            if (err < 0) {
+                statusFlags |= AUDIO_OUTPUT_UNDERFLOW;
+                snd_pcm_recover(stream.pcm, err, 1);
+                continue;
+            }
+            char* data = static_cast<char*>(areas[0].addr) +
+                         (areas[0].first + offset * areas[0].step) / 8;
+            {
+                // catches allocation and locking in debug build
+                Utils::RealTime::RealTimeScope realTimeScope;
+                stream.config.outputCallback(data, frames, statusFlags,
+                                             stream.config.userData);
+            }
+            statusFlags = 0;
+
+            // device starts by itself once the buffer is full
+            snd_pcm_sframes_t committed =
+                snd_pcm_mmap_commit(stream.pcm, offset, frames);
+            if (committed < 0 ||
+                static_cast<snd_pcm_uframes_t>(committed) != frames) {
+                statusFlags |= AUDIO_OUTPUT_UNDERFLOW;
+                snd_pcm_recover(stream.pcm, committed < 0 ? committed : -EPIPE,
+                                1);
+            }
+        }
+    }
+    // left by a failed recovery, not by stopStream. The stream has to be
+    // startable again, the thread is joined there
+    if (stream.isRunning.exchange(false)) {
+        BasicLogger::getInstance().log(TAG, LogLevel::ERROR,
+                                       "Failed to recover playback stream");
+    }
+    BasicLogger::getInstance().log(TAG, LogLevel::DEBUG,
+                                   "*** PLAYBACK THREAD END ***");
+}
+
+}  // namespace Alsa
+}  // namespace Audio
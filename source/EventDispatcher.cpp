@@ -0,0 +1,134 @@
+#include "EventDispatcher.h"
+#include "BasicLogger.h"
+#include "Futex.h"
+
+using namespace Utils::Logger;
+
+namespace Utils {
+namespace Threading {
+
+static const std::string TAG = "EventDispatcher";
+
+/// Wake up at least this often to check if the dispatcher is still running
+static const std::chrono::milliseconds WAIT_TIMEOUT{100};
+
+constexpr size_t EventDispatcher::QUEUE_CAPACITY;
+
+EventDispatcher::EventDispatcher(const std::string& name)
+    : m_name{name},
+      m_wakeCounter{0},
+      m_isSleeping{false},
+      m_numEvents{0},
+      m_numDroppedEvents{0},
+      m_totalLatencyUs{0},
+      m_maxLatencyUs{0},
+      m_isRunning{true} {
+    m_dispatchThread =
+        std::make_unique<std::thread>(&EventDispatcher::dispatchLoop, this);
+}
+
+EventDispatcher::~EventDispatcher() {
+    m_isRunning = false;
+    m_wakeCounter.fetch_add(1, std::memory_order_release);
+    futexWake(m_wakeCounter);
+    m_dispatchThread->join();
+    BasicLogger::getInstance().log(
+        TAG, LogLevel::INFO,
+        m_name + " | " + std::to_string(getNumEvents()) +
+            " events | average latency " +
+            std::to_string(getAverageLatency().count()) +
+            " us | max latency " + std::to_string(getMaxLatency().count()) +
+            " us | " + std::to_string(getNumDroppedEvents()) + " dropped");
+}
+
+bool EventDispatcher::dispatch(Event event) {
+    QueuedEvent queuedEvent{std::move(event),
+                            std::chrono::steady_clock::now()};
+    if (!m_queue.tryPush(queuedEvent)) {
+        m_numDroppedEvents.fetch_add(1, std::memory_order_relaxed);
+        BasicLogger::getInstance().log(TAG, LogLevel::WARNING,
+                                       m_name + " | queue is full, event is "
+                                                "dropped");
+        return false;
+    }
+    // pairs with the store of m_isSleeping in dispatchLoop, so either the
+    // dispatcher sees the event or we see it sleeping
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (m_isSleeping.load(std::memory_order_relaxed)) {
+        m_wakeCounter.fetch_add(1, std::memory_order_release);
+        futexWake(m_wakeCounter);
+    }
+    return true;
+}
+
+uint64_t EventDispatcher::getNumEvents() const {
+    return m_numEvents.load(std::memory_order_relaxed);
+}
+
+uint64_t EventDispatcher::getNumDroppedEvents() const {
+    return m_numDroppedEvents.load(std::memory_order_relaxed);
+}
+
+std::chrono::microseconds EventDispatcher::getAverageLatency() const {
+    uint64_t numEvents = getNumEvents();
+    return std::chrono::microseconds(
+        numEvents > 0
+            ? m_totalLatencyUs.load(std::memory_order_relaxed) / numEvents
+            : 0);
+}
+
+std::chrono::microseconds EventDispatcher::getMaxLatency() const {
+    return std::chrono::microseconds(
+        m_maxLatencyUs.load(std::memory_order_relaxed));
+}
+
+void EventDispatcher::dispatchLoop() {
+    BasicLogger::getInstance().log(TAG, LogLevel::DEBUG,
+                                   "*** THREAD START *** " + m_name);
+    QueuedEvent queuedEvent;
+    while (true) {
+        while (m_queue.tryPop(queuedEvent)) {
+            run(queuedEvent);
+        }
+        if (!m_isRunning) {
+            // everything dispatched before stopping has run
+            break;
+        }
+        int wakeCounter = m_wakeCounter.load(std::memory_order_acquire);
+        m_isSleeping.store(true, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        // check again after announced sleeping, an event may have been
+        // pushed before dispatch could see it
+        if (m_queue.tryPop(queuedEvent)) {
+            m_isSleeping.store(false, std::memory_order_relaxed);
+            run(queuedEvent);
+            continue;
+        }
+        if (m_isRunning) {
+            futexWait(m_wakeCounter, wakeCounter, WAIT_TIMEOUT);
+        }
+        m_isSleeping.store(false, std::memory_order_relaxed);
+    }
+    BasicLogger::getInstance().log(TAG, LogLevel::DEBUG,
+                                   "*** THREAD END *** " + m_name);
+}
+
+void EventDispatcher::run(QueuedEvent& queuedEvent) {
+    uint64_t latencyUs =
+        std::chrono::duration_cast<std::chrono::microseconds>(
+            std::chrono::steady_clock::now() - queuedEvent.dispatchTime)
+            .count();
+    m_totalLatencyUs.fetch_add(latencyUs, std::memory_order_relaxed);
+    uint64_t maxLatencyUs = m_maxLatencyUs.load(std::memory_order_relaxed);
+    while (latencyUs > maxLatencyUs &&
+           !m_maxLatencyUs.compare_exchange_weak(maxLatencyUs, latencyUs,
+                                                 std::memory_order_relaxed)) {
+    }
+    m_numEvents.fetch_add(1, std::memory_order_relaxed);
+
+    queuedEvent.event();
+    // release what the event holds now, not when the slot is reused
+    queuedEvent.event = nullptr;
+}
+}  // namespace Threading
+}  // namespace Utils
@@ -0,0 +1,362 @@
+#include "FileAudioBackend.h"
+#include "BaseException.h"
+#include "BasicLogger.h"
+#include "RealTimeGuard.h"
+
+#include <cstring>
+
+using namespace Utils::Logger;
+using BaseClass::BaseException;
+
+namespace Audio {
+namespace File {
+
+static const std::string TAG = "FileAudioBackend";
+
+/// Default period is 10 ms
+static const unsigned int DEFAULT_PERIODS_PER_SECOND = 100;
+/// Size of the canonical WAV header written to output file
+static const size_t WAV_HEADER_SIZE = 44;
+static const uint16_t WAV_FORMAT_PCM = 1;
+
+static void throwError(const std::string& errorMsg) {
+    BasicLogger::getInstance().log(TAG, LogLevel::ERROR, errorMsg);
+
+    throw BaseException(errorMsg);
+}
+
+static bool isWavFile(const std::string& fileName) {
+    static const std::string WAV_EXTENSION = ".wav";
+    return fileName.size() >= WAV_EXTENSION.size() &&
+           fileName.compare(fileName.size() - WAV_EXTENSION.size(),
+                            WAV_EXTENSION.size(), WAV_EXTENSION) == 0;
+}
+
+// WAV fields are little endian whatever the host is
+static uint32_t readLittleEndian(const char* bytes, size_t size) {
+    uint32_t value = 0;
+    for (size_t i = 0; i < size; ++i) {
+        value |= static_cast<uint32_t>(static_cast<uint8_t>(bytes[i]))
+                 << (8 * i);
+    }
+    return value;
+}
+
+static void writeLittleEndian(std::ofstream& file,
+                              uint32_t value,
+                              size_t size) {
+    for (size_t i = 0; i < size; ++i) {
+        file.put(static_cast<char>((value >> (8 * i)) & 0xff));
+    }
+}
+
+// sleep until @c numFrames should have been played since @c startTime
+static void waitForFrames(std::chrono::steady_clock::time_point startTime,
+                          uint64_t numFrames,
+                          int sampleRate,
+                          float speed) {
+    if (speed <= 0) {
+        std::this_thread::yield();
+        return;
+    }
+    std::chrono::duration<double> elapsed(
+        static_cast<double>(numFrames) / (sampleRate * speed));
+    std::this_thread::sleep_until(
+        startTime +
+        std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+            elapsed));
+}
+
+FileAudioBackend::FileAudioBackend(const std::string& inputFile,
+                                   const std::string& outputFile,
+                                   float speed)
+    : m_inputFileName{inputFile},
+      m_outputFileName{outputFile},
+      m_speed{speed},
+      m_inputDataSize{0},
+      m_isOutputWav{false},
+      m_outputDataSize{0},
+      m_isInputEnded{false} {}
+
+FileAudioBackend::~FileAudioBackend() {
+    joinStream(m_inputStream);
+    joinStream(m_outputStream);
+    if (m_isOutputWav) {
+        updateOutputHeader();
+    }
+}
+
+void FileAudioBackend::addStream(const AudioBackendConfig& config) {
+    BasicLogger::getInstance().log(
+        TAG, LogLevel::DEBUG,
+        std::string("Adding file stream") + " | IOType " +
+            std::to_string(
+                static_cast<std::underlying_type<IOType>::type>(config.type)) +
+            " | sample rate " + std::to_string(config.sampleRate) +
+            " | sample size " + std::to_string(config.bitsPerSample) +
+            " | number of channels " + std::to_string(config.numChannels) +
+            " | speed " + std::to_string(m_speed));
+
+    std::lock_guard<std::mutex> lock(m_fileMtx);
+    if (config.sampleFormat != SampleFormat::INT16) {
+        throwError("Failed to add stream. Only 16 bits supported");
+    }
+    Stream* stream = getStream(config.type);
+    if (stream == nullptr) {
+        throwError("Failed to add stream. Invalid IOType");
+    }
+    if (stream->isAdded) {
+        throwError("Failed to add stream. Stream already added");
+    }
+
+    if (config.type == IOType::INPUT) {
+        openInputFile(config);
+    } else {
+        openOutputFile(config);
+    }
+    stream->config = config;
+    stream->periodSize = config.framesPerBuffer > 0
+                             ? config.framesPerBuffer
+                             : config.sampleRate / DEFAULT_PERIODS_PER_SECOND;
+    stream->buffer.assign(stream->periodSize * config.numChannels, 0);
+    stream->isAdded = true;
+}
+
+void FileAudioBackend::openInputFile(const AudioBackendConfig& config) {
+    if (m_inputFileName.empty()) {
+        return;
+    }
+    m_inputFile.open(m_inputFileName, std::ios::binary);
+    if (!m_inputFile) {
+        throwError("Failed to open " + m_inputFileName);
+    }
+    if (!isWavFile(m_inputFileName)) {
+        m_inputFile.seekg(0, std::ios::end);
+        m_inputDataSize = m_inputFile.tellg();
+        m_inputFile.seekg(0, std::ios::beg);
+        return;
+    }
+
+    char riffHeader[12];
+    if (!m_inputFile.read(riffHeader, sizeof(riffHeader)) ||
+        std::memcmp(riffHeader, "RIFF", 4) != 0 ||
+        std::memcmp(riffHeader + 8, "WAVE", 4) != 0) {
+        throwError(m_inputFileName + " is not a WAV file");
+    }
+    bool hasFormat = false;
+    char chunkHeader[8];
+    while (m_inputFile.read(chunkHeader, sizeof(chunkHeader))) {
+        uint32_t chunkSize = readLittleEndian(chunkHeader + 4, 4);
+        if (std::memcmp(chunkHeader, "data", 4) == 0) {
+            if (!hasFormat) {
+                break;
+            }
+            m_inputDataSize = chunkSize;
+            return;
+        }
+        if (std::memcmp(chunkHeader, "fmt ", 4) == 0 && chunkSize >= 16) {
+            char format[16];
+            m_inputFile.read(format, sizeof(format));
+            uint32_t audioFormat = readLittleEndian(format, 2);
+            uint32_t numChannels = readLittleEndian(format + 2, 2);
+            uint32_t sampleRate = readLittleEndian(format + 4, 4);
+            uint32_t bitsPerSample = readLittleEndian(format + 14, 2);
+            if (audioFormat != WAV_FORMAT_PCM ||
+                numChannels != static_cast<uint32_t>(config.numChannels) ||
+                sampleRate != static_cast<uint32_t>(config.sampleRate) ||
+                bitsPerSample != static_cast<uint32_t>(config.bitsPerSample)) {
+                throwError(m_inputFileName + " doesn't match stream config");
+            }
+            hasFormat = true;
+            chunkSize -= sizeof(format);
+        }
+        // chunks are padded to even size
+        m_inputFile.seekg(chunkSize + (chunkSize & 1), std::ios::cur);
+    }
+    throwError(m_inputFileName + " has no samples");
+}
+
+void FileAudioBackend::openOutputFile(const AudioBackendConfig& config) {
+    if (m_outputFileName.empty()) {
+        return;
+    }
+    m_outputFile.open(m_outputFileName, std::ios::binary | std::ios::trunc);
+    if (!m_outputFile) {
+        throwError("Failed to open " + m_outputFileName);
+    }
+    m_isOutputWav = isWavFile(m_outputFileName);
+    if (m_isOutputWav) {
+        uint32_t blockAlign = config.numChannels * config.bitsPerSample / 8;
+        m_outputFile.write("RIFF", 4);
+        // sizes are filled by updateOutputHeader
+        writeLittleEndian(m_outputFile, WAV_HEADER_SIZE - 8, 4);
+        m_outputFile.write("WAVEfmt ", 8);
+        writeLittleEndian(m_outputFile, 16, 4);
+        writeLittleEndian(m_outputFile, WAV_FORMAT_PCM, 2);
+        writeLittleEndian(m_outputFile, config.numChannels, 2);
+        writeLittleEndian(m_outputFile, config.sampleRate, 4);
+        writeLittleEndian(m_outputFile, config.sampleRate * blockAlign, 4);
+        writeLittleEndian(m_outputFile, blockAlign, 2);
+        writeLittleEndian(m_outputFile, config.bitsPerSample, 2);
+        m_outputFile.write("data", 4);
+        writeLittleEndian(m_outputFile, 0, 4);
+    }
+}
+
+void FileAudioBackend::updateOutputHeader() {
+    m_outputFile.seekp(4, std::ios::beg);
+    writeLittleEndian(m_outputFile, WAV_HEADER_SIZE - 8 + m_outputDataSize,
+                      4);
+    m_outputFile.seekp(WAV_HEADER_SIZE - 4, std::ios::beg);
+    writeLittleEndian(m_outputFile, m_outputDataSize, 4);
+    m_outputFile.seekp(0, std::ios::end);
+    m_outputFile.flush();
+}
+
+void FileAudioBackend::startStream(const IOType& type) {
+    std::lock_guard<std::mutex> lock(m_fileMtx);
+    Stream* stream = getStream(type);
+    if (stream == nullptr || !stream->isAdded) {
+        throwError("Failed to start stream. Invalid IOType");
+    }
+    if (stream->isRunning) {
+        return;
+    }
+
+    stream->isRunning = true;
+    if (type == IOType::INPUT) {
+        {
+            std::lock_guard<std::mutex> endLock(m_inputEndMtx);
+            m_isInputEnded = false;
+        }
+        stream->thread = std::make_unique<std::thread>(
+            &FileAudioBackend::inputLoop, this);
+    } else {
+        stream->thread = std::make_unique<std::thread>(
+            &FileAudioBackend::outputLoop, this);
+    }
+}
+
+void FileAudioBackend::stopStream(const IOType& type) {
+    std::lock_guard<std::mutex> lock(m_fileMtx);
+    Stream* stream = getStream(type);
+    if (stream == nullptr) {
+        throwError("Failed to stop stream. Invalid IOType");
+    }
+    joinStream(*stream);
+    if (type == IOType::OUTPUT && m_isOutputWav) {
+        updateOutputHeader();
+    }
+}
+
+void FileAudioBackend::joinStream(Stream& stream) {
+    stream.isRunning = false;
+    if (stream.thread) {
+        stream.thread->join();
+        stream.thread.reset();
+    }
+}
+
+bool FileAudioBackend::waitForInputEnd(std::chrono::milliseconds timeout) {
+    std::unique_lock<std::mutex> lock(m_inputEndMtx);
+    return m_cvInputEnd.wait_for(lock, timeout,
+                                 [this] { return m_isInputEnded; });
+}
+
+uint64_t FileAudioBackend::getNumInputFrames() const {
+    return m_inputStream.numFrames.load(std::memory_order_relaxed);
+}
+
+uint64_t FileAudioBackend::getNumOutputFrames() const {
+    return m_outputStream.numFrames.load(std::memory_order_relaxed);
+}
+
+FileAudioBackend::Stream* FileAudioBackend::getStream(const IOType& type) {
+    switch (type) {
+        case IOType::INPUT:
+            return &m_inputStream;
+        case IOType::OUTPUT:
+            return &m_outputStream;
+        default:
+            return nullptr;
+    }
+}
+
+void FileAudioBackend::inputLoop() {
+    BasicLogger::getInstance().log(TAG, LogLevel::DEBUG,
+                                   "*** INPUT THREAD START ***");
+    Stream& stream = m_inputStream;
+    const size_t frameSize = stream.config.numChannels * sizeof(int16_t);
+    auto startTime = std::chrono::steady_clock::now();
+    uint64_t numFrames = 0;
+    while (stream.isRunning) {
+        unsigned long frames = stream.periodSize;
+        if (m_inputFile.is_open()) {
+            if (m_inputDataSize / frameSize < frames) {
+                frames = m_inputDataSize / frameSize;
+            }
+            // samples are little endian, same as the hosts we run on
+            m_inputFile.read(reinterpret_cast<char*>(stream.buffer.data()),
+                             frames * frameSize);
+            frames = m_inputFile.gcount() / frameSize;
+            m_inputDataSize -= frames * frameSize;
+            if (frames == 0) {
+                BasicLogger::getInstance().log(
+                    TAG, LogLevel::INFO,
+                    "End of " + m_inputFileName + " after " +
+                        std::to_string(getNumInputFrames()) + " frames");
+                {
+                    std::lock_guard<std::mutex> lock(m_inputEndMtx);
+                    m_isInputEnded = true;
+                }
+                m_cvInputEnd.notify_all();
+                break;
+            }
+        }
+        // not a real-time scope, consumers may block in the callback until
+        // they take the samples, see isRealTime
+        stream.config.inputCallback(stream.buffer.data(), frames, 0,
+                                    stream.config.userData);
+        stream.numFrames.fetch_add(frames, std::memory_order_relaxed);
+        numFrames += frames;
+        waitForFrames(startTime, numFrames, stream.config.sampleRate,
+                      m_speed);
+    }
+    BasicLogger::getInstance().log(TAG, LogLevel::DEBUG,
+                                   "*** INPUT THREAD END ***");
+}
+
+void FileAudioBackend::outputLoop() {
+    BasicLogger::getInstance().log(TAG, LogLevel::DEBUG,
+                                   "*** OUTPUT THREAD START ***");
+    Stream& stream = m_outputStream;
+    const size_t periodBytes = stream.buffer.size() * sizeof(int16_t);
+    auto startTime = std::chrono::steady_clock::now();
+    uint64_t numFrames = 0;
+    while (stream.isRunning) {
+        {
+            // catches allocation and locking in debug build
+            Utils::RealTime::RealTimeScope realTimeScope;
+            stream.config.outputCallback(stream.buffer.data(),
+                                         stream.periodSize, 0,
+                                         stream.config.userData);
+        }
+        if (m_outputFile.is_open()) {
+            m_outputFile.write(
+                reinterpret_cast<const char*>(stream.buffer.data()),
+                periodBytes);
+            m_outputDataSize += periodBytes;
+        }
+        stream.numFrames.fetch_add(stream.periodSize,
+                                   std::memory_order_relaxed);
+        numFrames += stream.periodSize;
+        // unpaced output would only spin writing silence
+        waitForFrames(startTime, numFrames, stream.config.sampleRate,
+                      m_speed > 0 ? m_speed : 1.0f);
+    }
+    BasicLogger::getInstance().log(TAG, LogLevel::DEBUG,
+                                   "*** OUTPUT THREAD END ***");
+}
+
+}  // namespace File
+}  // namespace Audio
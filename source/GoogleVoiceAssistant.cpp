@@ -25,6 +25,13 @@ namespace VoiceAssistantService {
 
 static const std::string TAG = "GoogleVoiceAssistant";
 
+/// Upload at least 20 ms and at most 100 ms audio in one request
+static const int MAX_UPLOADS_PER_SECOND = 50;
+static const int MIN_UPLOADS_PER_SECOND = 10;
+
+/// Wake up at least this often to check if uploading is still needed
+static const std::chrono::milliseconds AUDIO_INPUT_READ_TIMEOUT{100};
+
 GoogleVoiceAssistant::GoogleVoiceAssistant(
     GoogleVoiceAssistantConfig&& config,
     std::unique_ptr<Audio::AudioOutputStream::Writer> writer,
@@ -115,7 +122,10 @@ void GoogleVoiceAssistant::threadLoop() {
 #else
     AssistRequest audioRequest;
     std::unique_ptr<std::thread> audioInputTransThread;
-    std::vector<Audio::AudioInputStreamSize> audioInputData;
+    const size_t maxUploadSamples =
+        m_gvaConfig.input_sample_rate_hertz / MIN_UPLOADS_PER_SECOND;
+    const size_t minUploadSamples =
+        m_gvaConfig.input_sample_rate_hertz / MAX_UPLOADS_PER_SECOND;
 #endif
 
     while (m_isRunning) {
@@ -168,17 +178,34 @@ void GoogleVoiceAssistant::threadLoop() {
                     BasicLogger::getInstance().log(TAG, LogLevel::INFO,
                                                    "Writing audio to GVA");
                     while (m_isReadingInput) {
-                        audioInputData.resize(m_reader->getAvailableNum());
-                        size_t nRead = m_reader->read(audioInputData.data(),
-                                                      audioInputData.size());
-                        if (nRead > 0) {
-                            audioRequest.set_audio_in(
-                                &((audioInputData)[0]),
-                                audioInputData.size() *
+                        if (0 == m_reader->wait(minUploadSamples,
+                                                AUDIO_INPUT_READ_TIMEOUT)) {
+                            if (m_reader->isWriterClosed()) {
+                                // end of stream, don't spin until it reopens
+                                std::this_thread::sleep_for(
+                                    AUDIO_INPUT_READ_TIMEOUT);
+                            }
+                            continue;
+                        }
+                        // copy straight from the stream storage into request
+                        auto regions = m_reader->peek(maxUploadSamples);
+                        audioRequest.set_audio_in(
+                            regions.data1,
+                            regions.size1 *
+                                sizeof(Audio::AudioInputStreamSize));
+                        if (regions.size2 > 0) {
+                            audioRequest.mutable_audio_in()->append(
+                                reinterpret_cast<const char*>(regions.data2),
+                                regions.size2 *
                                     sizeof(Audio::AudioInputStreamSize));
+                        }
+                        if (m_reader->consume(regions.size())) {
                             m_clientRW->Write(audioRequest);
+                        } else {
+                            BasicLogger::getInstance().log(
+                                TAG, LogLevel::WARNING,
+                                "audio was overwritten while uploading");
                         }
-                        usleep(20000);
                     }
                     m_clientRW->WritesDone();
                     BasicLogger::getInstance().log(
@@ -235,8 +262,15 @@ void GoogleVoiceAssistant::threadLoop() {
                         std::memcpy(&data[0],
                                     response.audio_out().audio_data().c_str(),
                                     response.audio_out().audio_data().length());
-                        m_writer->write(&data[0], data.size());
+                        // output stream blocks writer when it is full, player
+                        // must be draining it before writing
                         m_player->startPlay();
+                        if (m_writer->write(&data[0], data.size()) <
+                            data.size()) {
+                            BasicLogger::getInstance().log(
+                                TAG, LogLevel::WARNING,
+                                "audio response is truncated");
+                        }
                     }
                     for (int i = 0; i < response.speech_results_size(); i++) {
                         auto result = response.speech_results(i);
@@ -300,13 +334,13 @@ void GoogleVoiceAssistant::setState(
 }
 
 void GoogleVoiceAssistant::onKeyWordDetected(std::string keyWord,
-                                             size_t readerIndex) {
+                                             uint64_t position) {
     if (keyWord == "jarvis") {
         BasicLogger::getInstance().log(TAG, LogLevel::INFO,
                                        "GVA is activied by KeyWord " + keyWord);
         setState(VoiceAssistantObserverInterface::VoiceAssistantState::
                      KEYWORD_TRIGGERED);
-        m_reader->setIndex(readerIndex);
+        m_reader->setPosition(position);
         // unblock m_thread
         m_cvStateChange.notify_one();
     }
@@ -6,7 +6,14 @@ using namespace Utils::Logger;
 namespace KeyWord {
 
 KeyWordDetector::KeyWordDetector()
-    : m_detectorState{KeyWordObserverInterface::KeyWordDetectorState::ERROR} {}
+    : m_detectorState{KeyWordObserverInterface::KeyWordDetectorState::ERROR},
+      m_eventDispatcher{std::make_unique<Utils::Threading::EventDispatcher>(
+          "KeyWordDetector")} {}
+
+const Utils::Threading::EventDispatcher& KeyWordDetector::getEventDispatcher()
+    const {
+    return *m_eventDispatcher;
+}
 
 void KeyWordDetector::addKeyWordObserver(
     std::shared_ptr<KeyWordObserverInterface> keyWordObserver) {
@@ -20,17 +27,30 @@ void KeyWordDetector::removeKeyWordObserver(
 }
 
 void KeyWordDetector::notifykeyWordObservers(std::string keyWord,
-                                             size_t readerIndex) const {
-    std::lock_guard<std::mutex> lock(m_keyWordObserversMtx);
-    for (auto keyWordObserver : m_keyWordObservers) {
-        keyWordObserver->onKeyWordDetected(keyWord, readerIndex);
-    }
+                                             uint64_t position) const {
+    m_eventDispatcher->dispatch([this, keyWord, position]() {
+        std::lock_guard<std::mutex> lock(m_keyWordObserversMtx);
+        for (auto keyWordObserver : m_keyWordObservers) {
+            keyWordObserver->onKeyWordDetected(keyWord, position);
+        }
+    });
 }
 void KeyWordDetector::notifykeyWordObservers(
     KeyWordObserverInterface::KeyWordDetectorState state) const {
-    std::lock_guard<std::mutex> lock(m_keyWordObserversMtx);
-    for (auto keyWordObserver : m_keyWordObservers) {
-        keyWordObserver->onStateChanged(state);
-    }
+    m_eventDispatcher->dispatch([this, state]() {
+        std::lock_guard<std::mutex> lock(m_keyWordObserversMtx);
+        for (auto keyWordObserver : m_keyWordObservers) {
+            keyWordObserver->onStateChanged(state);
+        }
+    });
+}
+void KeyWordDetector::notifykeyWordObservers(
+    KeyWordObserverInterface::VoiceActivityState state) const {
+    m_eventDispatcher->dispatch([this, state]() {
+        std::lock_guard<std::mutex> lock(m_keyWordObserversMtx);
+        for (auto keyWordObserver : m_keyWordObservers) {
+            keyWordObserver->onVoiceActivityChanged(state);
+        }
+    });
 }
 }  // namespace KeyWord
\ No newline at end of file
@@ -0,0 +1,92 @@
+#include "MirroredMemory.h"
+#include "BaseException.h"
+#include "BasicLogger.h"
+
+#include <cerrno>
+#include <cstring>
+
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+using namespace Utils::Logger;
+using BaseClass::BaseException;
+
+namespace Utils {
+namespace DataStructures {
+
+static const std::string TAG = "MirroredMemory";
+
+MirroredMemory::MirroredMemory(size_t size) : m_addr{nullptr}, m_size{size} {
+    if (size == 0 || size % pageSize() != 0) {
+        std::string errorMsg =
+            "Size of mirrored memory must be a multiple of page size";
+        BasicLogger::getInstance().log(TAG, LogLevel::ERROR, errorMsg);
+
+        throw BaseException(errorMsg);
+    }
+
+    // use syscall directly, old toolchains don't have memfd_create wrapper
+    int fd = static_cast<int>(syscall(SYS_memfd_create, "MirroredMemory", 0));
+    if (fd < 0) {
+        std::string errorMsg =
+            std::string("Failed to create memfd. ") + std::strerror(errno);
+        BasicLogger::getInstance().log(TAG, LogLevel::ERROR, errorMsg);
+
+        throw BaseException(errorMsg);
+    }
+    if (ftruncate(fd, size) != 0) {
+        std::string errorMsg =
+            std::string("Failed to resize memfd. ") + std::strerror(errno);
+        BasicLogger::getInstance().log(TAG, LogLevel::ERROR, errorMsg);
+        close(fd);
+
+        throw BaseException(errorMsg);
+    }
+
+    // reserve address space for two copies, then map the same pages into
+    // both halves
+    void* addr =
+        mmap(nullptr, 2 * size, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (addr == MAP_FAILED) {
+        std::string errorMsg = std::string("Failed to reserve address space. ") +
+                               std::strerror(errno);
+        BasicLogger::getInstance().log(TAG, LogLevel::ERROR, errorMsg);
+        close(fd);
+
+        throw BaseException(errorMsg);
+    }
+    char* base = static_cast<char*>(addr);
+    if (mmap(base, size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_FIXED, fd,
+             0) == MAP_FAILED ||
+        mmap(base + size, size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_FIXED,
+             fd, 0) == MAP_FAILED) {
+        std::string errorMsg =
+            std::string("Failed to map mirrored pages. ") + std::strerror(errno);
+        BasicLogger::getInstance().log(TAG, LogLevel::ERROR, errorMsg);
+        munmap(addr, 2 * size);
+        close(fd);
+
+        throw BaseException(errorMsg);
+    }
+    // mappings keep the memory alive
+    close(fd);
+    m_addr = addr;
+}
+
+MirroredMemory::~MirroredMemory() {
+    if (m_addr != nullptr) {
+        munmap(m_addr, 2 * m_size);
+    }
+}
+
+void* MirroredMemory::data() const { return m_addr; }
+
+size_t MirroredMemory::size() const { return m_size; }
+
+size_t MirroredMemory::pageSize() {
+    return static_cast<size_t>(sysconf(_SC_PAGESIZE));
+}
+
+}  // namespace DataStructures
+}  // namespace Utils
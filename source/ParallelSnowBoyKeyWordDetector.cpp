@@ -0,0 +1,149 @@
+#include "ParallelSnowBoyKeyWordDetector.h"
+#include <algorithm>
+#include "BaseException.h"
+
+using BaseClass::BaseException;
+
+namespace KeyWord {
+/// Same keyword from another shard within 1 s at snowboy rate is a duplicate
+static const uint64_t DUPLICATE_WINDOW = 16000;
+
+static const std::string TAG = "ParallelSnowBoyKeyWordDetector";
+
+ParallelSnowBoyKeyWordDetector::ShardObserver::ShardObserver(
+    ParallelSnowBoyKeyWordDetector& detector,
+    size_t shardIndex)
+    : m_detector(detector), m_shardIndex{shardIndex} {}
+
+void ParallelSnowBoyKeyWordDetector::ShardObserver::onKeyWordDetected(
+    std::string keyWord,
+    uint64_t position) {
+    m_detector.onShardKeyWordDetected(keyWord, position);
+}
+
+void ParallelSnowBoyKeyWordDetector::ShardObserver::onStateChanged(
+    KeyWordDetectorState state) {
+    m_detector.onShardStateChanged(state);
+}
+
+void ParallelSnowBoyKeyWordDetector::ShardObserver::onVoiceActivityChanged(
+    VoiceActivityState state) {
+    // every shard runs its own VAD on the same audio, report one of them
+    if (m_shardIndex == 0) {
+        m_detector.notifykeyWordObservers(state);
+    }
+}
+
+ParallelSnowBoyKeyWordDetector::ParallelSnowBoyKeyWordDetector(
+    std::vector<std::shared_ptr<Audio::AudioInputStream::Reader>> readers,
+    const std::vector<SnowBoyKeyWordDetector::SnowBoyModelConfig> configs,
+    const std::string& resourceFile,
+    const float audioGain,
+    const bool applyFrontEnd,
+    const std::chrono::milliseconds frameDuration,
+    const SnowBoyVadConfig& vadConfig)
+    : m_numShards{0},
+      m_state{KeyWordObserverInterface::KeyWordDetectorState::STOP},
+      m_numDetections{0},
+      m_numDuplicates{0} {
+    if (readers.empty() || configs.empty()) {
+        std::string errorMsg = "Received no reader or no model";
+        BasicLogger::getInstance().log(TAG, LogLevel::ERROR, errorMsg);
+
+        throw BaseException(errorMsg);
+    }
+    // a shard without model would only burn CPU
+    m_numShards = std::min(readers.size(), configs.size());
+    std::vector<std::vector<SnowBoyKeyWordDetector::SnowBoyModelConfig>>
+        shardConfigs(m_numShards);
+    for (size_t i = 0; i < configs.size(); ++i) {
+        shardConfigs[i % m_numShards].push_back(configs[i]);
+    }
+    for (size_t i = 0; i < m_numShards; ++i) {
+        m_shardObservers.push_back(std::make_shared<ShardObserver>(*this, i));
+        m_shards.push_back(std::make_unique<SnowBoyKeyWordDetector>(
+            readers[i], shardConfigs[i], resourceFile, audioGain,
+            applyFrontEnd, frameDuration, vadConfig));
+        m_shards.back()->addKeyWordObserver(m_shardObservers.back());
+    }
+    BasicLogger::getInstance().log(TAG, LogLevel::DEBUG,
+                                   std::to_string(configs.size()) +
+                                       " models in " +
+                                       std::to_string(m_numShards) +
+                                       " shards");
+}
+
+ParallelSnowBoyKeyWordDetector::~ParallelSnowBoyKeyWordDetector() {
+    // join all shards while the merger is still complete
+    m_shards.clear();
+    BasicLogger::getInstance().log(
+        TAG, LogLevel::INFO,
+        std::to_string(getNumDetections()) + " detections | " +
+            std::to_string(getNumDuplicates()) + " duplicates dropped");
+}
+
+size_t ParallelSnowBoyKeyWordDetector::getNumShards() const {
+    return m_numShards;
+}
+
+uint64_t ParallelSnowBoyKeyWordDetector::getNumDetections() const {
+    std::lock_guard<std::mutex> lock(m_mergeMtx);
+    return m_numDetections;
+}
+
+uint64_t ParallelSnowBoyKeyWordDetector::getNumDuplicates() const {
+    std::lock_guard<std::mutex> lock(m_mergeMtx);
+    return m_numDuplicates;
+}
+
+std::chrono::microseconds
+ParallelSnowBoyKeyWordDetector::getMaxDetectionLatency() const {
+    std::chrono::microseconds maxLatency{0};
+    for (auto& shard : m_shards) {
+        maxLatency = std::max(maxLatency, shard->getMaxDetectionLatency());
+    }
+    return maxLatency;
+}
+
+uint64_t ParallelSnowBoyKeyWordDetector::getNumProcessedSamples() const {
+    uint64_t numProcessed = UINT64_MAX;
+    for (auto& shard : m_shards) {
+        numProcessed = std::min(numProcessed, shard->getNumProcessedSamples());
+    }
+    return m_shards.empty() ? 0 : numProcessed;
+}
+
+void ParallelSnowBoyKeyWordDetector::onShardKeyWordDetected(
+    const std::string& keyWord,
+    uint64_t position) {
+    std::lock_guard<std::mutex> lock(m_mergeMtx);
+    auto lastDetection = m_lastDetectionPositions.find(keyWord);
+    if (lastDetection != m_lastDetectionPositions.end()) {
+        uint64_t lastPosition = lastDetection->second;
+        uint64_t distance = position > lastPosition ? position - lastPosition
+                                                    : lastPosition - position;
+        if (distance < DUPLICATE_WINDOW) {
+            ++m_numDuplicates;
+            BasicLogger::getInstance().log(
+                TAG, LogLevel::DEBUG,
+                std::string("Duplicate KeyWord dropped:") + keyWord);
+            return;
+        }
+    }
+    m_lastDetectionPositions[keyWord] = position;
+    ++m_numDetections;
+    notifykeyWordObservers(keyWord, position);
+}
+
+void ParallelSnowBoyKeyWordDetector::onShardStateChanged(
+    KeyWordObserverInterface::KeyWordDetectorState state) {
+    std::lock_guard<std::mutex> lock(m_mergeMtx);
+    // the first shard which becomes active or stops decides, errors of every
+    // shard are notified
+    if (state != m_state ||
+        state == KeyWordObserverInterface::KeyWordDetectorState::ERROR) {
+        m_state = state;
+        notifykeyWordObservers(state);
+    }
+}
+}  // namespace KeyWord
@@ -1,7 +1,8 @@
 #include "Player.h"
 #include "BaseException.h"
 
-using Audio::PortAudio::PortAudioWrapper;
+#include <cstring>
+
 using BaseClass::BaseException;
 using namespace Utils::Logger;
 
@@ -9,45 +10,36 @@ namespace Audio {
 namespace Player {
 static const std::string TAG = "Player";
 static const size_t F_BUFFER = 115200;
+/// 64 ms at 16 kHz, short enough that response starts playing promptly
+static const unsigned long FRAMES_PER_BUFFER = 1024;
 
 Player::Player(const int sampleRate,
                const int bitsPerSample,
                const int numChannels,
                std::shared_ptr<AudioOutputStream::Reader> reader,
-               std::shared_ptr<PortAudio::PortAudioWrapper> portAudioWrapper)
+               std::shared_ptr<AudioBackend> audioBackend)
     : m_reader{reader},
       m_sampleRate{sampleRate},
       m_bitsPerSample{bitsPerSample},
       m_numChannels{numChannels},
-      m_portAudioWrapper{portAudioWrapper},
+      m_audioBackend{audioBackend},
       m_isPlaying{false},
-      m_isReady{false} {
+      m_isReady{false},
+      m_hasDataToPlay{false},
+      m_numUnderrunSamples{0},
+      m_numUnderruns{0},
+      m_numOutputUnderflows{0},
+      m_reportedUnderrunSamples{0} {
     try {
-        PortAudioWrapper::PortAudioWrapperConfig config;
+        AudioBackend::AudioBackendConfig config;
         config.bitsPerSample = m_bitsPerSample;
         config.numChannels = m_numChannels;
         config.sampleRate = m_sampleRate;
-        config.type = PortAudio::IOType::OUTPUT;
-        config.outputCallbackInterface = [this](void* data,
-                                                unsigned long size) {
-            // Called by portaudio callback
-            std::vector<AudioOutputStreamSize> audioData;
-            size_t numNeedToRead = m_reader->getAvailableNum() > size
-                                       ? size
-                                       : m_reader->getAvailableNum();
-            audioData.resize(numNeedToRead);
-            size_t readNum = m_reader->read(audioData.data(), audioData.size());
-            if (readNum == 0) {
-                BasicLogger::getInstance().log(
-                    TAG, LogLevel::WARNING, "reader read nothing from stream");
-                m_hasDataToPlay = false;
-            } else {
-                std::memcpy(data, audioData.data(),
-                            audioData.size() * sizeof(AudioOutputStreamSize));
-                m_hasDataToPlay = true;
-            }
-        };
-        portAudioWrapper->addStream(config);
+        config.type = IOType::OUTPUT;
+        config.framesPerBuffer = FRAMES_PER_BUFFER;
+        config.outputCallback = &Player::onAudioRequested;
+        config.userData = this;
+        audioBackend->addStream(config);
     } catch (const std::bad_alloc& e) {
         BasicLogger::getInstance().log(TAG, LogLevel::ERROR,
                                        "Failed to allocate memory");
@@ -69,10 +61,45 @@ Player::~Player() {
 bool Player::isPlaying() const { return m_isPlaying; }
 bool Player::hasDataToPlay() const { return m_hasDataToPlay; }
 
+uint64_t Player::getNumUnderrunSamples() const {
+    return m_numUnderrunSamples.load(std::memory_order_relaxed);
+}
+
+uint64_t Player::getNumUnderruns() const {
+    return m_numUnderruns.load(std::memory_order_relaxed);
+}
+
+uint64_t Player::getNumOutputUnderflows() const {
+    return m_numOutputUnderflows.load(std::memory_order_relaxed);
+}
+
+void Player::onAudioRequested(void* data,
+                              unsigned long numSamples,
+                              unsigned long statusFlags,
+                              void* userData) {
+    auto player = static_cast<Player*>(userData);
+    if (statusFlags & AUDIO_OUTPUT_UNDERFLOW) {
+        player->m_numOutputUnderflows.fetch_add(1, std::memory_order_relaxed);
+    }
+    auto buffer = static_cast<AudioOutputStreamSize*>(data);
+    size_t bufferSize = numSamples * player->m_numChannels;
+
+    size_t readNum = player->m_reader->tryRead(buffer, bufferSize);
+    if (readNum < bufferSize) {
+        // don't let the device play whatever was left in its buffer
+        std::memset(buffer + readNum, 0,
+                    (bufferSize - readNum) * sizeof(AudioOutputStreamSize));
+        player->m_numUnderruns.fetch_add(1, std::memory_order_relaxed);
+        player->m_numUnderrunSamples.fetch_add(bufferSize - readNum,
+                                               std::memory_order_relaxed);
+    }
+    player->m_hasDataToPlay = readNum > 0;
+}
+
 void Player::startPlay() {
     if (m_isReady) {
         if (!m_isPlaying) {
-            m_portAudioWrapper->startStream(PortAudio::IOType::OUTPUT);
+            m_audioBackend->startStream(IOType::OUTPUT);
             m_isPlaying = true;
         }
     } else {
@@ -84,8 +111,18 @@ void Player::startPlay() {
 void Player::stopPlay() {
     if (m_isReady) {
         if (m_isPlaying) {
-            m_portAudioWrapper->stopStream(PortAudio::IOType::OUTPUT);
+            m_audioBackend->stopStream(IOType::OUTPUT);
             m_isPlaying = false;
+            uint64_t underrunSamples = getNumUnderrunSamples();
+            if (underrunSamples != m_reportedUnderrunSamples) {
+                BasicLogger::getInstance().log(
+                    TAG, LogLevel::DEBUG,
+                    "filled " +
+                        std::to_string(underrunSamples -
+                                       m_reportedUnderrunSamples) +
+                        " samples with silence while playing");
+                m_reportedUnderrunSamples = underrunSamples;
+            }
         }
     } else {
         BasicLogger::getInstance().log(TAG, LogLevel::ERROR,
@@ -1,12 +1,14 @@
 #include "PortAudioWrapper.h"
 #include "BaseException.h"
 #include "BasicLogger.h"
+#include "RealTimeGuard.h"
 
 #include "pa_util.h"
 
 #include <cstring>
 #include <functional>
 #include <memory>
+#include <type_traits>
 
 using namespace Utils::Logger;
 using BaseClass::BaseException;
@@ -16,11 +18,38 @@ namespace PortAudio {
 
 static const std::string TAG = "PortAudioWrapper";
 
-PortAudioWrapper::PortAudioWrapper()
-    : m_paInputStream{nullptr},
+// AudioBackend callbacks are passed to PortAudio ones as they are
+static_assert(std::is_same<PortAudioWrapper::InputCallback,
+                           AudioBackend::InputCallback>::value &&
+                  std::is_same<PortAudioWrapper::OutputCallback,
+                               AudioBackend::OutputCallback>::value,
+              "PortAudio callbacks must match AudioBackend callbacks");
+static_assert(paInputUnderflow == AUDIO_INPUT_UNDERFLOW &&
+                  paInputOverflow == AUDIO_INPUT_OVERFLOW &&
+                  paOutputUnderflow == AUDIO_OUTPUT_UNDERFLOW &&
+                  paOutputOverflow == AUDIO_OUTPUT_OVERFLOW,
+              "PortAudio status flags must match AudioBackend flags");
+
+PortAudioWrapper::PortAudioWrapper(bool isDuplex)
+    : m_inputCallback{nullptr},
+      m_inputUserData{nullptr},
+      m_outputCallback{nullptr},
+      m_outputUserData{nullptr},
+      m_duplexCallback{nullptr},
+      m_duplexUserData{nullptr},
+      m_isDuplex{isDuplex},
+      m_sharedConfig(),
+      m_hasSharedInput{false},
+      m_hasSharedOutput{false},
+      m_sharedOutputFrameSize{0},
+      m_isSharedInputStarted{false},
+      m_isSharedOutputStarted{false},
+      m_paInputStream{nullptr},
       m_paOutputStream{nullptr},
-      m_inputCallbackInterface{nullptr},
-      m_outputCallbackInterface{nullptr} {
+      m_paDuplexStream{nullptr},
+      m_inputLatency{0},
+      m_outputLatency{0},
+      m_duplexLatency{0} {
     BasicLogger::getInstance().log(TAG, LogLevel::INFO,
                                    "Initializing PortAudio library");
     PaError paStatus = Pa_Initialize();
@@ -34,8 +63,13 @@ PortAudioWrapper::PortAudioWrapper()
 }
 
 PortAudioWrapper::~PortAudioWrapper() {
-    Pa_StopStream(m_paInputStream);
-    Pa_CloseStream(m_paInputStream);
+    for (PaStream* stream :
+         {m_paInputStream, m_paOutputStream, m_paDuplexStream}) {
+        if (stream != nullptr) {
+            Pa_StopStream(stream);
+            Pa_CloseStream(stream);
+        }
+    }
     Pa_Terminate();
 }
 
@@ -47,35 +81,71 @@ void PortAudioWrapper::addStream(const PortAudioWrapperConfig& config) {
                 static_cast<std::underlying_type<IOType>::type>(config.type)) +
             " | sample rate " + std::to_string(config.sampleRate) +
             " | sample size " + std::to_string(config.bitsPerSample) +
-            " | number of channels " + std::to_string(config.numChannels));
+            " | number of channels " + std::to_string(config.numChannels) +
+            " | frames per buffer " + std::to_string(config.framesPerBuffer) +
+            " | suggested latency " + std::to_string(config.suggestedLatency));
 
     std::lock_guard<std::mutex> lock(m_portAudioMtx);
     // Prepare stream parameters
-    PaStreamParameters streamParameters;
-    std::memset(&streamParameters, 0, sizeof(streamParameters));
+    PaStreamParameters inputParameters;
+    std::memset(&inputParameters, 0, sizeof(inputParameters));
+    inputParameters.device = Pa_GetDefaultInputDevice();
+    inputParameters.channelCount = config.numChannels;
+    inputParameters.sampleFormat = config.sampleFormat;
+    inputParameters.hostApiSpecificStreamInfo = nullptr;
+
+    PaStreamParameters outputParameters;
+    std::memset(&outputParameters, 0, sizeof(outputParameters));
+    outputParameters.device = Pa_GetDefaultOutputDevice();
+    outputParameters.channelCount = config.numChannels;
+    outputParameters.sampleFormat = config.sampleFormat;
+    outputParameters.hostApiSpecificStreamInfo = nullptr;
+
+    if (config.type != IOType::OUTPUT) {
+        inputParameters.suggestedLatency =
+            config.suggestedLatency > 0
+                ? config.suggestedLatency
+                : Pa_GetDeviceInfo(inputParameters.device)
+                      ->defaultLowInputLatency;
+    }
+    if (config.type != IOType::INPUT) {
+        outputParameters.suggestedLatency =
+            config.suggestedLatency > 0
+                ? config.suggestedLatency
+                : Pa_GetDeviceInfo(outputParameters.device)
+                      ->defaultLowOutputLatency;
+    }
 
     PaError paStatus;
 
+    // Ok, open stream
     switch (config.type) {
         case IOType::INPUT:
-            streamParameters.device = Pa_GetDefaultInputDevice();
-            streamParameters.channelCount = config.numChannels;
-            streamParameters.sampleFormat = paInt16;
-            streamParameters.suggestedLatency =
-                Pa_GetDeviceInfo(streamParameters.device)
-                    ->defaultLowInputLatency;
-            streamParameters.hostApiSpecificStreamInfo = nullptr;
-            m_inputCallbackInterface = config.inputCallbackInterface;
+            m_inputCallback = config.inputCallback;
+            m_inputUserData = config.inputUserData;
+            paStatus = Pa_OpenStream(&(m_paInputStream), &inputParameters,
+                                     nullptr, config.sampleRate,
+                                     config.framesPerBuffer, config.streamFlags,
+                                     portAudioInputCallback, this);
             break;
         case IOType::OUTPUT:
-            streamParameters.device = Pa_GetDefaultOutputDevice();
-            streamParameters.channelCount = config.numChannels;
-            streamParameters.sampleFormat = paInt16;
-            streamParameters.suggestedLatency =
-                Pa_GetDeviceInfo(streamParameters.device)
-                    ->defaultLowOutputLatency;
-            streamParameters.hostApiSpecificStreamInfo = nullptr;
-            m_outputCallbackInterface = config.outputCallbackInterface;
+            m_outputCallback = config.outputCallback;
+            m_outputUserData = config.outputUserData;
+            paStatus = Pa_OpenStream(&(m_paOutputStream), nullptr,
+                                     &outputParameters, config.sampleRate,
+                                     config.framesPerBuffer, config.streamFlags,
+                                     portAudioOutputCallback, this);
+            break;
+        case IOType::DUPLEX:
+            if (config.outputNumChannels > 0) {
+                outputParameters.channelCount = config.outputNumChannels;
+            }
+            m_duplexCallback = config.duplexCallback;
+            m_duplexUserData = config.duplexUserData;
+            paStatus = Pa_OpenStream(&(m_paDuplexStream), &inputParameters,
+                                     &outputParameters, config.sampleRate,
+                                     config.framesPerBuffer, config.streamFlags,
+                                     portAudioDuplexCallback, this);
             break;
         default:
             std::string errorMsg = "Failed to add stream. Invalid IOType";
@@ -84,18 +154,6 @@ void PortAudioWrapper::addStream(const PortAudioWrapperConfig& config) {
             throw BaseException(errorMsg);
     }
 
-    // Ok, open stream
-    if (IOType::INPUT == config.type) {
-        paStatus =
-            Pa_OpenStream(&(m_paInputStream), &streamParameters, nullptr,
-                          config.sampleRate, paFramesPerBufferUnspecified,
-                          paNoFlag, portAudioInputCallback, this);
-    } else if (IOType::OUTPUT == config.type) {
-        paStatus = Pa_OpenStream(&(m_paOutputStream), nullptr,
-                                 &streamParameters, config.sampleRate, 4096,
-                                 paNoFlag, portAudioOutputCallback, this);
-    }
-
     if (paStatus != paNoError) {
         std::string errorMsg = "Failed to open PortAudio stream.";
         BasicLogger::getInstance().log(TAG, LogLevel::ERROR,
@@ -103,27 +161,132 @@ void PortAudioWrapper::addStream(const PortAudioWrapperConfig& config) {
 
         throw BaseException(errorMsg);
     }
-}
 
-void PortAudioWrapper::startStream(const IOType& type) {
-    std::lock_guard<std::mutex> lock(m_portAudioMtx);
-    PaError paStatus;
-
-    switch (type) {
+    // host may not give what is suggested, report what we actually got
+    const PaStreamInfo* streamInfo = Pa_GetStreamInfo(*getStream(config.type));
+    PaTime latency = 0;
+    if (streamInfo != nullptr) {
+        latency = streamInfo->inputLatency + streamInfo->outputLatency;
+    }
+    switch (config.type) {
         case IOType::INPUT:
-            paStatus = Pa_StartStream(m_paInputStream);
+            m_inputLatency = latency;
             break;
         case IOType::OUTPUT:
-            paStatus = Pa_StartStream(m_paOutputStream);
+            m_outputLatency = latency;
+            break;
+        case IOType::DUPLEX:
+            m_duplexLatency = latency;
             break;
+    }
+    BasicLogger::getInstance().log(
+        TAG, LogLevel::INFO,
+        "Stream latency " + std::to_string(latency) + "s | IOType " +
+            std::to_string(
+                static_cast<std::underlying_type<IOType>::type>(config.type)));
+}
+
+void PortAudioWrapper::addStream(const AudioBackendConfig& config) {
+    if (config.type == IOType::DUPLEX) {
+        std::string errorMsg =
+            "Failed to add stream. DUPLEX needs PortAudioWrapperConfig";
+        BasicLogger::getInstance().log(TAG, LogLevel::ERROR, errorMsg);
 
+        throw BaseException(errorMsg);
+    }
+    PortAudioWrapperConfig paConfig;
+    paConfig.sampleRate = config.sampleRate;
+    paConfig.numChannels = config.numChannels;
+    paConfig.bitsPerSample = config.bitsPerSample;
+    paConfig.type = config.type;
+    switch (config.sampleFormat) {
+        case SampleFormat::INT24:
+            paConfig.sampleFormat = paInt24;
+            break;
+        case SampleFormat::INT32:
+            paConfig.sampleFormat = paInt32;
+            break;
+        case SampleFormat::FLOAT32:
+            paConfig.sampleFormat = paFloat32;
+            break;
         default:
-            std::string errorMsg = "Failed to start stream. Invalid IOType";
+            paConfig.sampleFormat = paInt16;
+            break;
+    }
+    paConfig.inputCallback = config.inputCallback;
+    paConfig.inputUserData = config.userData;
+    paConfig.outputCallback = config.outputCallback;
+    paConfig.outputUserData = config.userData;
+    if (config.framesPerBuffer > 0) {
+        paConfig.framesPerBuffer = config.framesPerBuffer;
+    }
+    if (config.type == IOType::OUTPUT) {
+        // fill the first buffers from stream instead of silence
+        paConfig.streamFlags = paPrimeOutputBuffersUsingStreamCallback;
+    }
+    if (m_isDuplex) {
+        addSharedStream(paConfig);
+    } else {
+        addStream(paConfig);
+    }
+}
+
+void PortAudioWrapper::addSharedStream(const PortAudioWrapperConfig& config) {
+    bool hasBoth;
+    {
+        std::lock_guard<std::mutex> lock(m_portAudioMtx);
+        if ((m_hasSharedInput || m_hasSharedOutput) &&
+            (config.sampleRate != m_sharedConfig.sampleRate ||
+             config.numChannels != m_sharedConfig.numChannels ||
+             config.sampleFormat != m_sharedConfig.sampleFormat)) {
+            std::string errorMsg =
+                "Failed to add stream. INPUT and OUTPUT of DUPLEX stream must "
+                "have same sample rate, channels and format";
             BasicLogger::getInstance().log(TAG, LogLevel::ERROR, errorMsg);
 
             throw BaseException(errorMsg);
-            break;
+        }
+        if (!m_hasSharedInput && !m_hasSharedOutput) {
+            m_sharedConfig = config;
+            m_sharedConfig.type = IOType::DUPLEX;
+            m_sharedConfig.inputCallback = nullptr;
+            m_sharedConfig.outputCallback = nullptr;
+            m_sharedConfig.duplexCallback = forwardDuplexCallback;
+            m_sharedConfig.duplexUserData = this;
+        }
+        if (config.type == IOType::INPUT) {
+            m_inputCallback = config.inputCallback;
+            m_inputUserData = config.inputUserData;
+            m_hasSharedInput = true;
+        } else {
+            m_outputCallback = config.outputCallback;
+            m_outputUserData = config.outputUserData;
+            m_sharedConfig.streamFlags |= config.streamFlags;
+            m_hasSharedOutput = true;
+        }
+        m_sharedOutputFrameSize = config.numChannels *
+                                  Pa_GetSampleSize(m_sharedConfig.sampleFormat);
+        hasBoth = m_hasSharedInput && m_hasSharedOutput;
+    }
+    if (hasBoth) {
+        addStream(m_sharedConfig);
+    }
+}
+
+void PortAudioWrapper::startStream(const IOType& type) {
+    if (m_isDuplex && type != IOType::DUPLEX) {
+        startSharedStream(type);
+        return;
     }
+    std::lock_guard<std::mutex> lock(m_portAudioMtx);
+    PaStream** stream = getStream(type);
+    if (stream == nullptr) {
+        std::string errorMsg = "Failed to start stream. Invalid IOType";
+        BasicLogger::getInstance().log(TAG, LogLevel::ERROR, errorMsg);
+
+        throw BaseException(errorMsg);
+    }
+    PaError paStatus = Pa_StartStream(*stream);
     if (paStatus != paNoError) {
         std::string errorMsg =
             std::string("Failed to start stream.") + Pa_GetErrorText(paStatus);
@@ -133,24 +296,65 @@ void PortAudioWrapper::startStream(const IOType& type) {
 }
 
 void PortAudioWrapper::stopStream(const IOType& type) {
+    if (m_isDuplex && type != IOType::DUPLEX) {
+        stopSharedStream(type);
+        return;
+    }
     std::lock_guard<std::mutex> lock(m_portAudioMtx);
-    PaError paStatus;
+    PaStream** stream = getStream(type);
+    if (stream == nullptr) {
+        std::string errorMsg = "Failed to stop stream. Invalid IOType";
+        BasicLogger::getInstance().log(TAG, LogLevel::ERROR, errorMsg);
 
-    switch (type) {
-        case IOType::INPUT:
-            paStatus = Pa_StopStream(m_paInputStream);
-            break;
-        case IOType::OUTPUT:
-            paStatus = Pa_StopStream(m_paOutputStream);
-            break;
+        throw BaseException(errorMsg);
+    }
+    PaError paStatus = Pa_StopStream(*stream);
+    if (paStatus != paNoError) {
+        std::string errorMsg = std::string("Failed to stop PortAudio stream.") +
+                               Pa_GetErrorText(paStatus);
+        BasicLogger::getInstance().log(TAG, LogLevel::ERROR, errorMsg);
+        throw BaseException(errorMsg);
+    }
+}
 
-        default:
-            std::string errorMsg = "Failed to stop stream. Invalid IOType";
-            BasicLogger::getInstance().log(TAG, LogLevel::ERROR, errorMsg);
+void PortAudioWrapper::startSharedStream(const IOType& type) {
+    std::lock_guard<std::mutex> lock(m_portAudioMtx);
+    if (m_paDuplexStream == nullptr) {
+        std::string errorMsg =
+            "Failed to start stream. DUPLEX stream needs both INPUT and OUTPUT";
+        BasicLogger::getInstance().log(TAG, LogLevel::ERROR, errorMsg);
 
+        throw BaseException(errorMsg);
+    }
+    if (type == IOType::INPUT) {
+        m_isSharedInputStarted = true;
+    } else {
+        m_isSharedOutputStarted = true;
+    }
+    if (Pa_IsStreamStopped(m_paDuplexStream) == 1) {
+        PaError paStatus = Pa_StartStream(m_paDuplexStream);
+        if (paStatus != paNoError) {
+            std::string errorMsg = std::string("Failed to start stream.") +
+                                   Pa_GetErrorText(paStatus);
+            BasicLogger::getInstance().log(TAG, LogLevel::ERROR, errorMsg);
             throw BaseException(errorMsg);
-            break;
+        }
+    }
+}
+
+void PortAudioWrapper::stopSharedStream(const IOType& type) {
+    std::lock_guard<std::mutex> lock(m_portAudioMtx);
+    if (type == IOType::INPUT) {
+        m_isSharedInputStarted = false;
+    } else {
+        m_isSharedOutputStarted = false;
+    }
+    // keep the clock running while the other direction still uses it
+    if (m_paDuplexStream == nullptr || m_isSharedInputStarted ||
+        m_isSharedOutputStarted) {
+        return;
     }
+    PaError paStatus = Pa_StopStream(m_paDuplexStream);
     if (paStatus != paNoError) {
         std::string errorMsg = std::string("Failed to stop PortAudio stream.") +
                                Pa_GetErrorText(paStatus);
@@ -159,6 +363,129 @@ void PortAudioWrapper::stopStream(const IOType& type) {
     }
 }
 
+PaTime PortAudioWrapper::getStreamLatency(const IOType& type) {
+    std::lock_guard<std::mutex> lock(m_portAudioMtx);
+    switch (type) {
+        case IOType::INPUT:
+            return m_inputLatency;
+        case IOType::OUTPUT:
+            return m_outputLatency;
+        case IOType::DUPLEX:
+            return m_duplexLatency;
+        default:
+            return 0;
+    }
+}
+
+StreamStatistics PortAudioWrapper::getStreamStatistics(const IOType& type) {
+    StreamStatistics statistics;
+    std::memset(&statistics, 0, sizeof(statistics));
+    PaStream** stream = getStream(type);
+    if (stream == nullptr) {
+        BasicLogger::getInstance().log(TAG, LogLevel::ERROR,
+                                       "getStreamStatistics: Invalid IOType");
+        return statistics;
+    }
+
+    const StreamCounters& counters =
+        m_streamCounters[static_cast<size_t>(type)];
+    statistics.numCallbacks = counters.numCallbacks.load();
+    statistics.numInputOverflows = counters.numInputOverflows.load();
+    statistics.numInputUnderflows = counters.numInputUnderflows.load();
+    statistics.numOutputOverflows = counters.numOutputOverflows.load();
+    statistics.numOutputUnderflows = counters.numOutputUnderflows.load();
+    for (size_t i = 0; i < NUM_CALLBACK_DURATION_BUCKETS; i++) {
+        statistics.callbackDurationHistogram[i] =
+            counters.callbackDurationHistogram[i].load();
+    }
+    statistics.maxCallbackDurationUs = counters.maxCallbackDurationUs.load();
+    statistics.inputLatencyUs = counters.inputLatencyUs.load();
+    statistics.maxInputLatencyUs = counters.maxInputLatencyUs.load();
+    statistics.outputLatencyUs = counters.outputLatencyUs.load();
+    statistics.maxOutputLatencyUs = counters.maxOutputLatencyUs.load();
+
+    std::lock_guard<std::mutex> lock(m_portAudioMtx);
+    if (*stream != nullptr) {
+        statistics.cpuLoad = Pa_GetStreamCpuLoad(*stream);
+    }
+    return statistics;
+}
+
+void PortAudioWrapper::updateCounters(
+    const IOType& type,
+    const PaStreamCallbackTimeInfo* timeInfo,
+    PaStreamCallbackFlags statusFlags,
+    std::chrono::steady_clock::time_point callbackStart) {
+    StreamCounters& counters = m_streamCounters[static_cast<size_t>(type)];
+    // only the callback writes counters, no need of read-modify-write atomics
+    auto increase = [](std::atomic<uint64_t>& counter) {
+        counter.store(counter.load(std::memory_order_relaxed) + 1,
+                      std::memory_order_relaxed);
+    };
+    auto raiseMax = [](auto& max, decltype(max.load()) value) {
+        if (value > max.load(std::memory_order_relaxed)) {
+            max.store(value, std::memory_order_relaxed);
+        }
+    };
+
+    increase(counters.numCallbacks);
+    if (statusFlags & paInputOverflow) {
+        increase(counters.numInputOverflows);
+    }
+    if (statusFlags & paInputUnderflow) {
+        increase(counters.numInputUnderflows);
+    }
+    if (statusFlags & paOutputOverflow) {
+        increase(counters.numOutputOverflows);
+    }
+    if (statusFlags & paOutputUnderflow) {
+        increase(counters.numOutputUnderflows);
+    }
+
+    uint64_t durationUs =
+        std::chrono::duration_cast<std::chrono::microseconds>(
+            std::chrono::steady_clock::now() - callbackStart)
+            .count();
+    size_t bucket = 0;
+    for (uint64_t us = durationUs;
+         us > 0 && bucket < NUM_CALLBACK_DURATION_BUCKETS - 1; us >>= 1) {
+        bucket++;
+    }
+    increase(counters.callbackDurationHistogram[bucket]);
+    raiseMax(counters.maxCallbackDurationUs, durationUs);
+
+    // some hosts don't provide timing, all of it is 0 then
+    if (timeInfo != nullptr && timeInfo->currentTime > 0) {
+        if (type != IOType::OUTPUT && timeInfo->inputBufferAdcTime > 0) {
+            int64_t latencyUs = static_cast<int64_t>(
+                (timeInfo->currentTime - timeInfo->inputBufferAdcTime) * 1e6);
+            counters.inputLatencyUs.store(latencyUs,
+                                          std::memory_order_relaxed);
+            raiseMax(counters.maxInputLatencyUs, latencyUs);
+        }
+        if (type != IOType::INPUT && timeInfo->outputBufferDacTime > 0) {
+            int64_t latencyUs = static_cast<int64_t>(
+                (timeInfo->outputBufferDacTime - timeInfo->currentTime) * 1e6);
+            counters.outputLatencyUs.store(latencyUs,
+                                           std::memory_order_relaxed);
+            raiseMax(counters.maxOutputLatencyUs, latencyUs);
+        }
+    }
+}
+
+PaStream** PortAudioWrapper::getStream(const IOType& type) {
+    switch (type) {
+        case IOType::INPUT:
+            return &m_paInputStream;
+        case IOType::OUTPUT:
+            return &m_paOutputStream;
+        case IOType::DUPLEX:
+            return &m_paDuplexStream;
+        default:
+            return nullptr;
+    }
+}
+
 int PortAudioWrapper::portAudioInputCallback(
     const void* inputBuffer,
     void* outputBuffer,
@@ -166,11 +493,17 @@ int PortAudioWrapper::portAudioInputCallback(
     const PaStreamCallbackTimeInfo* timeInfo,
     PaStreamCallbackFlags statusFlags,
     void* userData) {
+    // catches allocation and locking in debug build
+    Utils::RealTime::RealTimeScope realTimeScope;
+    auto callbackStart = std::chrono::steady_clock::now();
     auto paWrapper = static_cast<PortAudioWrapper*>(userData);
 
-    if (paWrapper->m_inputCallbackInterface != nullptr) {
-        paWrapper->m_inputCallbackInterface(inputBuffer, numSamples);
+    if (paWrapper->m_inputCallback != nullptr) {
+        paWrapper->m_inputCallback(inputBuffer, numSamples, statusFlags,
+                                   paWrapper->m_inputUserData);
     }
+    paWrapper->updateCounters(IOType::INPUT, timeInfo, statusFlags,
+                              callbackStart);
     return paContinue;
 }
 
@@ -181,13 +514,70 @@ int PortAudioWrapper::portAudioOutputCallback(
     const PaStreamCallbackTimeInfo* timeInfo,
     PaStreamCallbackFlags statusFlags,
     void* userData) {
+    // catches allocation and locking in debug build
+    Utils::RealTime::RealTimeScope realTimeScope;
+    auto callbackStart = std::chrono::steady_clock::now();
     auto paWrapper = static_cast<PortAudioWrapper*>(userData);
 
-    if (paWrapper->m_outputCallbackInterface != nullptr) {
-        paWrapper->m_outputCallbackInterface(outputBuffer, numSamples);
+    if (paWrapper->m_outputCallback != nullptr) {
+        paWrapper->m_outputCallback(outputBuffer, numSamples, statusFlags,
+                                    paWrapper->m_outputUserData);
     }
+    paWrapper->updateCounters(IOType::OUTPUT, timeInfo, statusFlags,
+                              callbackStart);
     return paContinue;
 }
 
+int PortAudioWrapper::portAudioDuplexCallback(
+    const void* inputBuffer,
+    void* outputBuffer,
+    unsigned long numSamples,
+    const PaStreamCallbackTimeInfo* timeInfo,
+    PaStreamCallbackFlags statusFlags,
+    void* userData) {
+    // catches allocation and locking in debug build
+    Utils::RealTime::RealTimeScope realTimeScope;
+    auto callbackStart = std::chrono::steady_clock::now();
+    auto paWrapper = static_cast<PortAudioWrapper*>(userData);
+
+    if (paWrapper->m_duplexCallback != nullptr) {
+        paWrapper->m_duplexCallback(inputBuffer, outputBuffer, numSamples,
+                                    timeInfo, statusFlags,
+                                    paWrapper->m_duplexUserData);
+    }
+    paWrapper->updateCounters(IOType::DUPLEX, timeInfo, statusFlags,
+                              callbackStart);
+    return paContinue;
+}
+
+void PortAudioWrapper::forwardDuplexCallback(
+    const void* input,
+    void* output,
+    unsigned long numSamples,
+    const PaStreamCallbackTimeInfo* /*timeInfo*/,
+    PaStreamCallbackFlags statusFlags,
+    void* userData) {
+    auto paWrapper = static_cast<PortAudioWrapper*>(userData);
+
+    // capture first, so a reference of what is captured is there before the
+    // output of the same period is filled
+    if (paWrapper->m_isSharedInputStarted.load(std::memory_order_relaxed) &&
+        paWrapper->m_inputCallback != nullptr) {
+        paWrapper->m_inputCallback(
+            input, numSamples,
+            statusFlags & (paInputUnderflow | paInputOverflow),
+            paWrapper->m_inputUserData);
+    }
+    if (paWrapper->m_isSharedOutputStarted.load(std::memory_order_relaxed) &&
+        paWrapper->m_outputCallback != nullptr) {
+        paWrapper->m_outputCallback(
+            output, numSamples,
+            statusFlags & (paOutputUnderflow | paOutputOverflow),
+            paWrapper->m_outputUserData);
+    } else {
+        std::memset(output, 0, numSamples * paWrapper->m_sharedOutputFrameSize);
+    }
+}
+
 }  // namespace PortAudio
 }  // namespace Audio
@@ -0,0 +1,82 @@
+#include "RealTimeGuard.h"
+
+#ifdef REALTIME_GUARD
+
+#include <cstdlib>
+#include <cstring>
+
+#include <dlfcn.h>
+#include <pthread.h>
+#include <unistd.h>
+
+// glibc entry points behind the interposed functions
+extern "C" void* __libc_malloc(size_t size);
+extern "C" void* __libc_calloc(size_t num, size_t size);
+extern "C" void* __libc_realloc(void* ptr, size_t size);
+
+namespace Utils {
+namespace RealTime {
+
+static thread_local bool isRealTimeThread = false;
+// set while the handler runs, so it can log without recursing
+static thread_local bool isInHandler = false;
+
+static void abortOnViolation(const char* operation) {
+    // no allocation here, write straight to stderr
+    static const char msg[] = "RealTimeGuard: real-time thread called ";
+    ssize_t ret = write(STDERR_FILENO, msg, sizeof(msg) - 1);
+    ret = write(STDERR_FILENO, operation, std::strlen(operation));
+    ret = write(STDERR_FILENO, "\n", 1);
+    (void)ret;
+    std::abort();
+}
+
+static ViolationHandler violationHandler = abortOnViolation;
+
+static void check(const char* operation) {
+    if (isRealTimeThread && !isInHandler) {
+        isInHandler = true;
+        violationHandler(operation);
+        isInHandler = false;
+    }
+}
+
+bool markRealTimeThread(bool isRealTime) {
+    bool wasRealTime = isRealTimeThread;
+    isRealTimeThread = isRealTime;
+    return wasRealTime;
+}
+
+void setViolationHandler(ViolationHandler handler) {
+    violationHandler = handler != nullptr ? handler : abortOnViolation;
+}
+
+}  // namespace RealTime
+}  // namespace Utils
+
+using Utils::RealTime::check;
+
+extern "C" void* malloc(size_t size) {
+    check("malloc");
+    return __libc_malloc(size);
+}
+
+extern "C" void* calloc(size_t num, size_t size) {
+    check("calloc");
+    return __libc_calloc(num, size);
+}
+
+extern "C" void* realloc(void* ptr, size_t size) {
+    check("realloc");
+    return __libc_realloc(ptr, size);
+}
+
+extern "C" int pthread_mutex_lock(pthread_mutex_t* mutex) {
+    using MutexLock = int (*)(pthread_mutex_t*);
+    static MutexLock realMutexLock =
+        reinterpret_cast<MutexLock>(dlsym(RTLD_NEXT, "pthread_mutex_lock"));
+    check("pthread_mutex_lock");
+    return realMutexLock(mutex);
+}
+
+#endif
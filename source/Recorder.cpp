@@ -1,7 +1,9 @@
 #include "Recorder.h"
 #include "BaseException.h"
 
-using Audio::PortAudio::PortAudioWrapper;
+#include <algorithm>
+#include <type_traits>
+
 using BaseClass::BaseException;
 using namespace Utils::Logger;
 
@@ -9,37 +11,128 @@ namespace Audio {
 namespace Recorder {
 static const std::string TAG = "Recorder";
 
+/// How often errors of the capture callback are logged
+static const std::chrono::seconds ERROR_REPORT_PERIOD{1};
+
+/// Samples converted at once when device format isn't stream format
+static const size_t CONVERSION_BUFFER_SIZE = 1024;
+
+Recorder::Recorder(const int sampleRate,
+                   const int bitsPerSample,
+                   const int numChannels,
+                   std::unique_ptr<AudioInputStream::Writer> writer,
+                   std::shared_ptr<AudioBackend> audioBackend,
+                   const SampleFormat deviceFormat)
+    : Recorder(sampleRate,
+               bitsPerSample,
+               numChannels,
+               std::move(writer),
+               nullptr,
+               {},
+               audioBackend,
+               deviceFormat) {}
+
+Recorder::Recorder(const int sampleRate,
+                   const int bitsPerSample,
+                   const int numChannels,
+                   std::unique_ptr<AudioInputStream::Writer> writer,
+                   std::unique_ptr<AudioInputFloatStream::Writer> floatWriter,
+                   std::shared_ptr<AudioBackend> audioBackend,
+                   const SampleFormat deviceFormat)
+    : Recorder(sampleRate,
+               bitsPerSample,
+               numChannels,
+               std::move(writer),
+               std::move(floatWriter),
+               {},
+               audioBackend,
+               deviceFormat) {}
+
 Recorder::Recorder(
     const int sampleRate,
     const int bitsPerSample,
-    const int numChannels,
-    std::unique_ptr<AudioInputStream::Writer> writer,
-    std::shared_ptr<PortAudio::PortAudioWrapper> portAudioWrapper)
-    : m_writer{std::move(writer)},
-      m_sampleRate{sampleRate},
+    std::vector<std::unique_ptr<AudioInputStream::Writer>> channelWriters,
+    std::shared_ptr<AudioBackend> audioBackend,
+    const SampleFormat deviceFormat)
+    : Recorder(sampleRate,
+               bitsPerSample,
+               channelWriters.size(),
+               nullptr,
+               nullptr,
+               std::move(channelWriters),
+               audioBackend,
+               deviceFormat) {}
+
+Recorder::Recorder(const int sampleRate,
+                   const int bitsPerSample,
+                   const int numChannels,
+                   std::unique_ptr<AudioInputStream::Writer> writer,
+                   std::unique_ptr<AudioInputFloatStream::Writer> floatWriter,
+                   std::vector<std::unique_ptr<AudioInputStream::Writer>>
+                       &&channelWriters,
+                   std::shared_ptr<AudioBackend> audioBackend,
+                   const SampleFormat deviceFormat)
+    : m_sampleRate{sampleRate},
       m_bitsPerSample{bitsPerSample},
       m_numChannels{numChannels},
-      m_portAudioWrapper{portAudioWrapper},
+      m_deviceFormat{deviceFormat},
+      m_audioBackend{audioBackend},
+      m_isBlockingWrite{audioBackend != nullptr && !audioBackend->isRealTime()},
+      m_writer{std::move(writer)},
+      m_floatWriter{std::move(floatWriter)},
+      m_channelWriters{std::move(channelWriters)},
+      m_converter{deviceFormat},
+      m_isReady{false},
       m_isRecording{false},
-      m_isReady{false} {
+      m_numFailedWrites{0},
+      m_numDroppedSamples{0},
+      m_numInputOverflows{0},
+      m_isErrorReportRunning{false} {
     try {
-        PortAudioWrapper::PortAudioWrapperConfig config;
-        config.bitsPerSample = m_bitsPerSample;
+        AudioBackend::AudioBackendConfig config;
+        bool hasWriter = m_writer != nullptr || m_floatWriter != nullptr ||
+                         !m_channelWriters.empty();
+        for (auto& channelWriter : m_channelWriters) {
+            hasWriter = hasWriter && channelWriter != nullptr;
+        }
+        if (!hasWriter) {
+            std::string errorMsg = "Received a null writer";
+            BasicLogger::getInstance().log(TAG, LogLevel::ERROR, errorMsg);
+
+            throw BaseException(errorMsg);
+        }
+        // a frame of every channel must fit in one conversion buffer
+        if (m_numChannels < 1 ||
+            static_cast<size_t>(m_numChannels) > CONVERSION_BUFFER_SIZE) {
+            std::string errorMsg =
+                "Unsupported num of channels " + std::to_string(m_numChannels);
+            BasicLogger::getInstance().log(TAG, LogLevel::ERROR, errorMsg);
+
+            throw BaseException(errorMsg);
+        }
+        if (m_floatWriter != nullptr) {
+            m_floatConversionBuffer.resize(CONVERSION_BUFFER_SIZE);
+        }
+        if (m_floatWriter == nullptr || m_writer != nullptr) {
+            m_conversionBuffer.resize(CONVERSION_BUFFER_SIZE);
+        }
+        // channels of one conversion buffer of frames
+        for (size_t i = 0; i < m_channelWriters.size(); ++i) {
+            m_channelBuffers.emplace_back(CONVERSION_BUFFER_SIZE /
+                                          m_channelWriters.size());
+            m_channelBufferPointers.push_back(m_channelBuffers.back().data());
+        }
+        config.bitsPerSample = getBitsPerSample(m_deviceFormat);
         config.numChannels = m_numChannels;
         config.sampleRate = m_sampleRate;
-        config.type = PortAudio::IOType::INPUT;
-        config.inputCallbackInterface = [this](const void* data,
-                                               unsigned long size) {
-            // Called by portaudio callback
-            size_t writtenNum = m_writer->write(
-                static_cast<const AudioInputStreamSize*>(data), size);
-
-            if (writtenNum == 0) {
-                BasicLogger::getInstance().log(TAG, LogLevel::WARNING,
-                                               "Failed when trying to write");
-            }
-        };
-        portAudioWrapper->addStream(config);
+        config.type = IOType::INPUT;
+        config.sampleFormat = m_deviceFormat;
+        config.inputCallback = &Recorder::onAudioCaptured;
+        config.userData = this;
+        audioBackend->addStream(config);
+        m_isErrorReportRunning = true;
+        m_errorReportThread =
+            std::make_unique<std::thread>(&Recorder::errorReportLoop, this);
     } catch (const std::bad_alloc& e) {
         BasicLogger::getInstance().log(TAG, LogLevel::ERROR,
                                        "Failed to allocate memory");
@@ -56,15 +149,180 @@ Recorder::Recorder(
 Recorder::~Recorder() {
     if (m_isRecording) stopRecord();
     m_isReady = false;
+    if (m_errorReportThread) {
+        {
+            std::lock_guard<std::mutex> lock(m_errorReportMtx);
+            m_isErrorReportRunning = false;
+        }
+        m_cvErrorReport.notify_one();
+        m_errorReportThread->join();
+    }
 }
 
 bool Recorder::isRecording() const { return m_isRecording; }
 
+uint64_t Recorder::getNumFailedWrites() const {
+    return m_numFailedWrites.load(std::memory_order_relaxed);
+}
+
+uint64_t Recorder::getNumDroppedSamples() const {
+    return m_numDroppedSamples.load(std::memory_order_relaxed);
+}
+
+uint64_t Recorder::getNumInputOverflows() const {
+    return m_numInputOverflows.load(std::memory_order_relaxed);
+}
+
+void Recorder::onAudioCaptured(const void* data,
+                               unsigned long numSamples,
+                               unsigned long statusFlags,
+                               void* userData) {
+    auto recorder = static_cast<Recorder*>(userData);
+    if (statusFlags & AUDIO_INPUT_OVERFLOW) {
+        recorder->m_numInputOverflows.fetch_add(1, std::memory_order_relaxed);
+    }
+    // interleaved, one sample per channel in each frame
+    size_t numFrames = numSamples;
+    numSamples = numFrames * recorder->m_numChannels;
+    size_t droppedNum = 0;
+    if (!recorder->m_channelWriters.empty()) {
+        droppedNum = recorder->writeChannels(data, numFrames);
+    }
+    if (recorder->m_writer != nullptr) {
+        droppedNum += numSamples - recorder->writeSamples(
+                                       *recorder->m_writer,
+                                       recorder->m_conversionBuffer, data,
+                                       numSamples);
+    }
+    if (recorder->m_floatWriter != nullptr) {
+        droppedNum += numSamples - recorder->writeSamples(
+                                       *recorder->m_floatWriter,
+                                       recorder->m_floatConversionBuffer, data,
+                                       numSamples);
+    }
+    if (droppedNum > 0) {
+        recorder->m_numFailedWrites.fetch_add(1, std::memory_order_relaxed);
+        recorder->m_numDroppedSamples.fetch_add(droppedNum,
+                                                std::memory_order_relaxed);
+    }
+}
+
+template <typename Writer, typename T>
+size_t Recorder::writeToStream(Writer& writer,
+                               const T* data,
+                               size_t numSamples) {
+    return m_isBlockingWrite ? writer.write(data, numSamples)
+                             : writer.tryWrite(data, numSamples);
+}
+
+template <typename Writer, typename T>
+size_t Recorder::writeSamples(Writer& writer,
+                              std::vector<T>& buffer,
+                              const void* data,
+                              size_t numSamples) {
+    if (std::is_same<T, AudioInputStreamSize>::value &&
+        m_deviceFormat == SampleFormat::INT16) {
+        // nothing to convert
+        return writeToStream(writer, static_cast<const T*>(data), numSamples);
+    }
+    auto bytes = static_cast<const uint8_t*>(data);
+    const size_t sampleSize = getSampleSize(m_deviceFormat);
+    size_t writtenNum = 0;
+    while (writtenNum < numSamples) {
+        size_t chunkSize = std::min(buffer.size(), numSamples - writtenNum);
+        m_converter.convert(bytes + writtenNum * sampleSize, buffer.data(),
+                            chunkSize);
+        size_t num = writeToStream(writer, buffer.data(), chunkSize);
+        writtenNum += num;
+        if (num < chunkSize) {
+            break;
+        }
+    }
+    return writtenNum;
+}
+
+size_t Recorder::writeChannels(const void* data, size_t numFrames) {
+    const size_t numChannels = m_channelWriters.size();
+    const size_t frameSize = getSampleSize(m_deviceFormat) * numChannels;
+    const size_t chunkFrames = CONVERSION_BUFFER_SIZE / numChannels;
+    auto bytes = static_cast<const uint8_t*>(data);
+    size_t droppedNum = 0;
+    for (size_t frame = 0; frame < numFrames; frame += chunkFrames) {
+        size_t chunkSize = std::min(chunkFrames, numFrames - frame);
+        const AudioInputStreamSize* interleaved;
+        if (m_deviceFormat == SampleFormat::INT16) {
+            interleaved = reinterpret_cast<const AudioInputStreamSize*>(bytes) +
+                          frame * numChannels;
+        } else {
+            m_converter.convert(bytes + frame * frameSize,
+                                m_conversionBuffer.data(),
+                                chunkSize * numChannels);
+            interleaved = m_conversionBuffer.data();
+        }
+        deinterleave(interleaved, numChannels, chunkSize,
+                     m_channelBufferPointers.data());
+        for (size_t channel = 0; channel < numChannels; ++channel) {
+            droppedNum += chunkSize - writeToStream(
+                                          *m_channelWriters[channel],
+                                          m_channelBufferPointers[channel],
+                                          chunkSize);
+        }
+    }
+    return droppedNum;
+}
+
+template <typename Function>
+void Recorder::forEachWriter(Function function) {
+    if (m_writer != nullptr) {
+        function(*m_writer);
+    }
+    if (m_floatWriter != nullptr) {
+        function(*m_floatWriter);
+    }
+    for (auto& channelWriter : m_channelWriters) {
+        function(*channelWriter);
+    }
+}
+
+void Recorder::errorReportLoop() {
+    uint64_t reportedFailedWrites = 0;
+    uint64_t reportedDroppedSamples = 0;
+    uint64_t reportedInputOverflows = 0;
+    std::unique_lock<std::mutex> lock(m_errorReportMtx);
+    while (m_isErrorReportRunning) {
+        m_cvErrorReport.wait_for(lock, ERROR_REPORT_PERIOD,
+                                 [this] { return !m_isErrorReportRunning; });
+
+        uint64_t failedWrites = getNumFailedWrites();
+        uint64_t droppedSamples = getNumDroppedSamples();
+        if (failedWrites != reportedFailedWrites) {
+            BasicLogger::getInstance().log(
+                TAG, LogLevel::WARNING,
+                "Failed when trying to write " +
+                    std::to_string(failedWrites - reportedFailedWrites) +
+                    " times, dropped " +
+                    std::to_string(droppedSamples - reportedDroppedSamples) +
+                    " samples");
+            reportedFailedWrites = failedWrites;
+            reportedDroppedSamples = droppedSamples;
+        }
+        uint64_t inputOverflows = getNumInputOverflows();
+        if (inputOverflows != reportedInputOverflows) {
+            BasicLogger::getInstance().log(
+                TAG, LogLevel::WARNING,
+                "Input overflowed " +
+                    std::to_string(inputOverflows - reportedInputOverflows) +
+                    " times");
+            reportedInputOverflows = inputOverflows;
+        }
+    }
+}
+
 void Recorder::startRecord() {
     if (m_isReady) {
         if (!m_isRecording) {
-            m_writer->open();
-            m_portAudioWrapper->startStream(PortAudio::IOType::INPUT);
+            forEachWriter([](auto& writer) { writer.open(); });
+            m_audioBackend->startStream(IOType::INPUT);
             m_isRecording = true;
         }
     } else {
@@ -76,8 +334,8 @@ void Recorder::startRecord() {
 void Recorder::stopRecord() {
     if (m_isReady) {
         if (m_isRecording) {
-            m_portAudioWrapper->stopStream(PortAudio::IOType::INPUT);
-            m_writer->close();
+            m_audioBackend->stopStream(IOType::INPUT);
+            forEachWriter([](auto& writer) { writer.close(); });
             m_isRecording = false;
         }
     } else {
@@ -0,0 +1,213 @@
+#include "Resampler.h"
+#include "BaseException.h"
+#include "BasicLogger.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#endif
+
+using namespace Utils::Logger;
+using BaseClass::BaseException;
+
+namespace Audio {
+
+static const std::string TAG = "Resampler";
+
+/// Taps per phase when upsampling, scaled by the ratio when downsampling
+static const size_t MIN_TAPS_PER_PHASE = 32;
+/// Taps per phase are padded to whole SIMD registers
+static const size_t TAPS_ALIGNMENT = 8;
+/// Cut off frequency relative to the lower Nyquist rate
+static const double CUTOFF_RATIO = 0.9;
+/// About 80 dB stop band attenuation
+static const double KAISER_BETA = 8.0;
+static const double PI = 3.14159265358979323846;
+
+static size_t greatestCommonDivisor(size_t a, size_t b) {
+    while (b != 0) {
+        size_t remainder = a % b;
+        a = b;
+        b = remainder;
+    }
+    return a;
+}
+
+// zeroth order modified Bessel function of the first kind, for Kaiser window
+static double besselI0(double x) {
+    double sum = 1.0;
+    double term = 1.0;
+    for (int k = 1; k < 64 && term > sum * 1e-12; ++k) {
+        double factor = x / (2.0 * k);
+        term *= factor * factor;
+        sum += term;
+    }
+    return sum;
+}
+
+static float dotProduct(const float* a, const float* b, size_t num) {
+    size_t i = 0;
+    float sum = 0;
+#if defined(__AVX2__)
+    __m256 acc = _mm256_setzero_ps();
+    for (; i + 8 <= num; i += 8) {
+        acc = _mm256_add_ps(
+            acc, _mm256_mul_ps(_mm256_loadu_ps(a + i), _mm256_loadu_ps(b + i)));
+    }
+    __m128 half = _mm_add_ps(_mm256_castps256_ps128(acc),
+                             _mm256_extractf128_ps(acc, 1));
+    half = _mm_add_ps(half, _mm_movehl_ps(half, half));
+    half = _mm_add_ss(half, _mm_shuffle_ps(half, half, 1));
+    sum = _mm_cvtss_f32(half);
+#elif defined(__SSE2__)
+    __m128 acc = _mm_setzero_ps();
+    for (; i + 4 <= num; i += 4) {
+        acc = _mm_add_ps(acc,
+                         _mm_mul_ps(_mm_loadu_ps(a + i), _mm_loadu_ps(b + i)));
+    }
+    acc = _mm_add_ps(acc, _mm_movehl_ps(acc, acc));
+    acc = _mm_add_ss(acc, _mm_shuffle_ps(acc, acc, 1));
+    sum = _mm_cvtss_f32(acc);
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+    float32x4_t acc = vdupq_n_f32(0);
+    for (; i + 4 <= num; i += 4) {
+        acc = vmlaq_f32(acc, vld1q_f32(a + i), vld1q_f32(b + i));
+    }
+    float32x2_t pair = vadd_f32(vget_low_f32(acc), vget_high_f32(acc));
+    sum = vget_lane_f32(vpadd_f32(pair, pair), 0);
+#endif
+    for (; i < num; ++i) {
+        sum += a[i] * b[i];
+    }
+    return sum;
+}
+
+Resampler::Resampler(int inputRate, int outputRate, size_t maxInputNum)
+    : m_inputRate{inputRate},
+      m_outputRate{outputRate},
+      m_maxInputNum{maxInputNum} {
+    if (inputRate <= 0 || outputRate <= 0 || maxInputNum == 0) {
+        std::string errorMsg = "Invalid resampler config";
+        BasicLogger::getInstance().log(TAG, LogLevel::ERROR, errorMsg);
+
+        throw BaseException(errorMsg);
+    }
+    size_t divisor = greatestCommonDivisor(inputRate, outputRate);
+    m_upFactor = outputRate / divisor;
+    m_downFactor = inputRate / divisor;
+    // longer filter for a narrower transition band when downsampling
+    m_numTapsPerPhase =
+        MIN_TAPS_PER_PHASE *
+        std::max<size_t>(1, (m_downFactor + m_upFactor - 1) / m_upFactor);
+    m_numTapsPerPhase = (m_numTapsPerPhase + TAPS_ALIGNMENT - 1) /
+                        TAPS_ALIGNMENT * TAPS_ALIGNMENT;
+
+    // prototype low pass runs at inputRate * m_upFactor
+    size_t numTaps = m_numTapsPerPhase * m_upFactor;
+    double cutoff = CUTOFF_RATIO * 0.5 * std::min(inputRate, outputRate) /
+                    (static_cast<double>(inputRate) * m_upFactor);
+    double center = (numTaps - 1) / 2.0;
+    std::vector<double> taps(numTaps);
+    for (size_t n = 0; n < numTaps; ++n) {
+        double x = n - center;
+        double sinc = x == 0 ? 2 * cutoff
+                             : std::sin(2 * PI * cutoff * x) / (PI * x);
+        double ratio = numTaps > 1 ? 2.0 * n / (numTaps - 1) - 1 : 0;
+        double window = besselI0(KAISER_BETA * std::sqrt(1 - ratio * ratio)) /
+                        besselI0(KAISER_BETA);
+        taps[n] = sinc * window;
+    }
+
+    m_coefficients.resize(numTaps);
+    for (size_t phase = 0; phase < m_upFactor; ++phase) {
+        float* coefficients = &m_coefficients[phase * m_numTapsPerPhase];
+        double sum = 0;
+        for (size_t k = 0; k < m_numTapsPerPhase; ++k) {
+            sum += taps[phase + k * m_upFactor];
+        }
+        // tap k weights the input k samples before the newest one, unity
+        // gain at DC for every phase
+        for (size_t k = 0; k < m_numTapsPerPhase; ++k) {
+            coefficients[m_numTapsPerPhase - 1 - k] =
+                static_cast<float>(taps[phase + k * m_upFactor] / sum);
+        }
+    }
+    m_history.resize(m_numTapsPerPhase - 1 + m_maxInputNum);
+    reset();
+
+    BasicLogger::getInstance().log(
+        TAG, LogLevel::DEBUG,
+        std::to_string(inputRate) + " -> " + std::to_string(outputRate) +
+            " | up " + std::to_string(m_upFactor) + " | down " +
+            std::to_string(m_downFactor) + " | taps per phase " +
+            std::to_string(m_numTapsPerPhase));
+}
+
+void Resampler::reset() {
+    std::fill(m_history.begin(), m_history.end(), 0.0f);
+    m_historyNum = m_numTapsPerPhase - 1;
+    // first output ends on the first input
+    m_time = m_historyNum * m_upFactor;
+}
+
+size_t Resampler::getMaxOutputNum(size_t numInput) const {
+    return (numInput * m_upFactor + m_downFactor - 1) / m_downFactor + 1;
+}
+
+size_t Resampler::getNumTapsPerPhase() const { return m_numTapsPerPhase; }
+
+size_t Resampler::getDelay() const {
+    return (m_numTapsPerPhase * m_upFactor - 1) / (2 * m_upFactor);
+}
+
+size_t Resampler::process(const int16_t* input,
+                          size_t numInput,
+                          int16_t* output) {
+    size_t outputNum = 0;
+    while (numInput > 0) {
+        size_t chunkSize = std::min(numInput, m_maxInputNum);
+        outputNum += processChunk(input, chunkSize, output + outputNum);
+        input += chunkSize;
+        numInput -= chunkSize;
+    }
+    return outputNum;
+}
+
+size_t Resampler::processChunk(const int16_t* input,
+                               size_t numInput,
+                               int16_t* output) {
+    float* history = m_history.data();
+    for (size_t i = 0; i < numInput; ++i) {
+        history[m_historyNum + i] = input[i];
+    }
+    m_historyNum += numInput;
+
+    size_t outputNum = 0;
+    while (m_time / m_upFactor < m_historyNum) {
+        size_t newest = m_time / m_upFactor;
+        size_t phase = m_time % m_upFactor;
+        float value = dotProduct(
+            &m_coefficients[phase * m_numTapsPerPhase],
+            history + newest + 1 - m_numTapsPerPhase, m_numTapsPerPhase);
+        value = std::min(std::max(value, -32768.0f), 32767.0f);
+        output[outputNum++] = static_cast<int16_t>(std::lrint(value));
+        m_time += m_downFactor;
+    }
+
+    // keep what the next outputs still need
+    size_t dropNum = m_historyNum - (m_numTapsPerPhase - 1);
+    std::memmove(history, history + dropNum,
+                 (m_numTapsPerPhase - 1) * sizeof(float));
+    m_historyNum = m_numTapsPerPhase - 1;
+    m_time -= dropNum * m_upFactor;
+    return outputNum;
+}
+
+}  // namespace Audio
@@ -0,0 +1,380 @@
+#include "SampleConverter.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <type_traits>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#endif
+
+namespace Audio {
+
+/// Stream samples are in 16 bits range, whatever their type is
+static constexpr float INT16_MIN_VALUE = -32768.0f;
+static constexpr float INT16_MAX_VALUE = 32767.0f;
+static constexpr float INT32_TO_STREAM_SCALE = 1.0f / 65536.0f;
+static constexpr float FLOAT_TO_STREAM_SCALE = 32768.0f;
+
+/// INT24 samples are widened to int32_t on stack in chunks of this size
+static const size_t INT24_CHUNK_SIZE = 256;
+
+// xorshift32, returns uniform noise in [-0.5, 0.5) LSB
+static inline float random(uint32_t& state) {
+    state ^= state << 13;
+    state ^= state >> 17;
+    state ^= state << 5;
+    // 23 random bits as mantissa of [1, 2)
+    uint32_t bits = (state >> 9) | 0x3f800000;
+    float value;
+    std::memcpy(&value, &bits, sizeof(value));
+    return value - 1.5f;
+}
+
+static inline void storeSample(float* output, float value) {
+    *output = value;
+}
+
+static inline void storeSample(int16_t* output, float value) {
+    value = std::min(std::max(value, INT16_MIN_VALUE), INT16_MAX_VALUE);
+    *output = static_cast<int16_t>(std::lrint(value));
+}
+
+#if defined(__AVX2__) || defined(__SSE2__) || defined(__ARM_NEON) || \
+    defined(__ARM_NEON__)
+#define HAS_SIMD_KERNELS
+namespace Simd {
+/*
+ * Same operations for every instruction set, so there is one kernel.
+ * Narrowing stores clamp to 16 bits range and round to nearest.
+ */
+#if defined(__AVX2__)
+using Float = __m256;
+using State = __m256i;
+static constexpr size_t NUM_LANES = 8;
+
+static inline Float set(float value) { return _mm256_set1_ps(value); }
+static inline Float add(Float a, Float b) { return _mm256_add_ps(a, b); }
+static inline Float mul(Float a, Float b) { return _mm256_mul_ps(a, b); }
+static inline Float load(const float* input) {
+    return _mm256_loadu_ps(input);
+}
+static inline Float load(const int32_t* input) {
+    return _mm256_cvtepi32_ps(
+        _mm256_loadu_si256(reinterpret_cast<const __m256i*>(input)));
+}
+static inline Float load(const int16_t* input) {
+    return _mm256_cvtepi32_ps(_mm256_cvtepi16_epi32(
+        _mm_loadu_si128(reinterpret_cast<const __m128i*>(input))));
+}
+static inline void store(float* output, Float value) {
+    _mm256_storeu_ps(output, value);
+}
+static inline void store(int16_t* output, Float value) {
+    value = _mm256_min_ps(_mm256_max_ps(value, set(INT16_MIN_VALUE)),
+                          set(INT16_MAX_VALUE));
+    __m256i samples = _mm256_cvtps_epi32(value);
+    _mm_storeu_si128(
+        reinterpret_cast<__m128i*>(output),
+        _mm_packs_epi32(_mm256_castsi256_si128(samples),
+                        _mm256_extracti128_si256(samples, 1)));
+}
+static inline State loadState(const uint32_t* state) {
+    return _mm256_loadu_si256(reinterpret_cast<const __m256i*>(state));
+}
+static inline void storeState(uint32_t* state, State value) {
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(state), value);
+}
+static inline Float random(State& state) {
+    state = _mm256_xor_si256(state, _mm256_slli_epi32(state, 13));
+    state = _mm256_xor_si256(state, _mm256_srli_epi32(state, 17));
+    state = _mm256_xor_si256(state, _mm256_slli_epi32(state, 5));
+    __m256i bits = _mm256_or_si256(_mm256_srli_epi32(state, 9),
+                                   _mm256_set1_epi32(0x3f800000));
+    return _mm256_sub_ps(_mm256_castsi256_ps(bits), set(1.5f));
+}
+#elif defined(__SSE2__)
+using Float = __m128;
+using State = __m128i;
+static constexpr size_t NUM_LANES = 4;
+
+static inline Float set(float value) { return _mm_set1_ps(value); }
+static inline Float add(Float a, Float b) { return _mm_add_ps(a, b); }
+static inline Float mul(Float a, Float b) { return _mm_mul_ps(a, b); }
+static inline Float load(const float* input) { return _mm_loadu_ps(input); }
+static inline Float load(const int32_t* input) {
+    return _mm_cvtepi32_ps(
+        _mm_loadu_si128(reinterpret_cast<const __m128i*>(input)));
+}
+static inline Float load(const int16_t* input) {
+    __m128i samples =
+        _mm_loadl_epi64(reinterpret_cast<const __m128i*>(input));
+    // sign extend by putting samples in high halves and shifting back
+    return _mm_cvtepi32_ps(
+        _mm_srai_epi32(_mm_unpacklo_epi16(samples, samples), 16));
+}
+static inline void store(float* output, Float value) {
+    _mm_storeu_ps(output, value);
+}
+static inline void store(int16_t* output, Float value) {
+    value = _mm_min_ps(_mm_max_ps(value, set(INT16_MIN_VALUE)),
+                       set(INT16_MAX_VALUE));
+    __m128i samples = _mm_cvtps_epi32(value);
+    _mm_storel_epi64(reinterpret_cast<__m128i*>(output),
+                     _mm_packs_epi32(samples, samples));
+}
+static inline State loadState(const uint32_t* state) {
+    return _mm_loadu_si128(reinterpret_cast<const __m128i*>(state));
+}
+static inline void storeState(uint32_t* state, State value) {
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(state), value);
+}
+static inline Float random(State& state) {
+    state = _mm_xor_si128(state, _mm_slli_epi32(state, 13));
+    state = _mm_xor_si128(state, _mm_srli_epi32(state, 17));
+    state = _mm_xor_si128(state, _mm_slli_epi32(state, 5));
+    __m128i bits = _mm_or_si128(_mm_srli_epi32(state, 9),
+                                _mm_set1_epi32(0x3f800000));
+    return _mm_sub_ps(_mm_castsi128_ps(bits), set(1.5f));
+}
+#else
+using Float = float32x4_t;
+using State = uint32x4_t;
+static constexpr size_t NUM_LANES = 4;
+
+static inline Float set(float value) { return vdupq_n_f32(value); }
+static inline Float add(Float a, Float b) { return vaddq_f32(a, b); }
+static inline Float mul(Float a, Float b) { return vmulq_f32(a, b); }
+static inline Float load(const float* input) { return vld1q_f32(input); }
+static inline Float load(const int32_t* input) {
+    return vcvtq_f32_s32(vld1q_s32(input));
+}
+static inline Float load(const int16_t* input) {
+    return vcvtq_f32_s32(vmovl_s16(vld1_s16(input)));
+}
+static inline void store(float* output, Float value) {
+    vst1q_f32(output, value);
+}
+static inline void store(int16_t* output, Float value) {
+    value = vminq_f32(vmaxq_f32(value, set(INT16_MIN_VALUE)),
+                      set(INT16_MAX_VALUE));
+    // armv7 only converts toward zero, round half away from zero instead
+    Float half = vbslq_f32(vcltq_f32(value, set(0.0f)), set(-0.5f),
+                           set(0.5f));
+    vst1_s16(output, vqmovn_s32(vcvtq_s32_f32(vaddq_f32(value, half))));
+}
+static inline State loadState(const uint32_t* state) {
+    return vld1q_u32(state);
+}
+static inline void storeState(uint32_t* state, State value) {
+    vst1q_u32(state, value);
+}
+static inline Float random(State& state) {
+    state = veorq_u32(state, vshlq_n_u32(state, 13));
+    state = veorq_u32(state, vshrq_n_u32(state, 17));
+    state = veorq_u32(state, vshlq_n_u32(state, 5));
+    uint32x4_t bits =
+        vorrq_u32(vshrq_n_u32(state, 9), vdupq_n_u32(0x3f800000));
+    return vsubq_f32(vreinterpretq_f32_u32(bits), set(1.5f));
+}
+#endif
+}  // namespace Simd
+#endif
+
+/*
+ * output = input * scale, plus TPDF dither of +-1 LSB if @c ditherState is
+ * not null. Sum of two uniform noises is triangular, which makes the
+ * quantization error independent of the signal.
+ */
+template <typename In, typename Out>
+static void convertSamples(const In* input,
+                           Out* output,
+                           size_t numSamples,
+                           float scale,
+                           uint32_t* ditherState) {
+    size_t i = 0;
+#ifdef HAS_SIMD_KERNELS
+    const Simd::Float simdScale = Simd::set(scale);
+    if (ditherState != nullptr) {
+        Simd::State state = Simd::loadState(ditherState);
+        for (; i + Simd::NUM_LANES <= numSamples; i += Simd::NUM_LANES) {
+            Simd::Float value = Simd::mul(Simd::load(input + i), simdScale);
+            value = Simd::add(value, Simd::add(Simd::random(state),
+                                               Simd::random(state)));
+            Simd::store(output + i, value);
+        }
+        Simd::storeState(ditherState, state);
+    } else {
+        for (; i + Simd::NUM_LANES <= numSamples; i += Simd::NUM_LANES) {
+            Simd::store(output + i,
+                        Simd::mul(Simd::load(input + i), simdScale));
+        }
+    }
+#endif
+    for (; i < numSamples; ++i) {
+        float value = static_cast<float>(input[i]) * scale;
+        if (ditherState != nullptr) {
+            value += random(ditherState[0]) + random(ditherState[0]);
+        }
+        storeSample(output + i, value);
+    }
+}
+
+SampleConverter::SampleConverter(SampleFormat inputFormat, bool shouldDither)
+    : m_inputFormat{inputFormat}, m_shouldDither{shouldDither} {
+    // any distinct non zero seeds
+    for (size_t i = 0; i < sizeof(m_ditherState) / sizeof(uint32_t); ++i) {
+        m_ditherState[i] = 0x9e3779b9u * (i + 1);
+    }
+}
+
+SampleFormat SampleConverter::getInputFormat() const { return m_inputFormat; }
+
+void SampleConverter::convert(const void* input,
+                              int16_t* output,
+                              size_t numSamples) {
+    convertTo(input, output, numSamples);
+}
+
+void SampleConverter::convert(const void* input,
+                              float* output,
+                              size_t numSamples) {
+    convertTo(input, output, numSamples);
+}
+
+template <typename T>
+void SampleConverter::convertTo(const void* input,
+                                T* output,
+                                size_t numSamples) {
+    // float stream has enough precision, dither only when narrowing
+    uint32_t* ditherState =
+        m_shouldDither && std::is_same<T, int16_t>::value ? m_ditherState
+                                                          : nullptr;
+    switch (m_inputFormat) {
+        case SampleFormat::INT16:
+            if (std::is_same<T, int16_t>::value) {
+                std::memcpy(output, input, numSamples * sizeof(T));
+            } else {
+                convertSamples(static_cast<const int16_t*>(input), output,
+                               numSamples, 1.0f, nullptr);
+            }
+            break;
+        case SampleFormat::INT24: {
+            auto bytes = static_cast<const uint8_t*>(input);
+            int32_t widened[INT24_CHUNK_SIZE];
+            for (size_t i = 0; i < numSamples; i += INT24_CHUNK_SIZE) {
+                size_t chunkSize = std::min(INT24_CHUNK_SIZE, numSamples - i);
+                for (size_t j = 0; j < chunkSize; ++j, bytes += 3) {
+                    // little endian, into the top 3 bytes of int32_t
+                    widened[j] = static_cast<int32_t>(
+                        static_cast<uint32_t>(bytes[0]) << 8 |
+                        static_cast<uint32_t>(bytes[1]) << 16 |
+                        static_cast<uint32_t>(bytes[2]) << 24);
+                }
+                convertSamples(widened, output + i, chunkSize,
+                               INT32_TO_STREAM_SCALE, ditherState);
+            }
+            break;
+        }
+        case SampleFormat::INT32:
+            convertSamples(static_cast<const int32_t*>(input), output,
+                           numSamples, INT32_TO_STREAM_SCALE, ditherState);
+            break;
+        case SampleFormat::FLOAT32:
+            convertSamples(static_cast<const float*>(input), output,
+                           numSamples, FLOAT_TO_STREAM_SCALE, ditherState);
+            break;
+    }
+}
+
+#if defined(__SSE2__)
+// samples 0, 2, 4.. of a then b, and samples 1, 3, 5.. of a then b
+static inline __m128i evenSamples(__m128i a, __m128i b) {
+    return _mm_packs_epi32(_mm_srai_epi32(_mm_slli_epi32(a, 16), 16),
+                           _mm_srai_epi32(_mm_slli_epi32(b, 16), 16));
+}
+
+static inline __m128i oddSamples(__m128i a, __m128i b) {
+    return _mm_packs_epi32(_mm_srai_epi32(a, 16), _mm_srai_epi32(b, 16));
+}
+
+static inline __m128i load(const int16_t* input) {
+    return _mm_loadu_si128(reinterpret_cast<const __m128i*>(input));
+}
+
+static inline void store(int16_t* output, __m128i samples) {
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(output), samples);
+}
+#endif
+
+void deinterleave(const int16_t* input,
+                  size_t numChannels,
+                  size_t numFrames,
+                  int16_t* const* outputs) {
+    size_t frame = 0;
+#if defined(__SSE2__)
+    // 8 frames per iteration
+    if (numChannels == 2) {
+        for (; frame + 8 <= numFrames; frame += 8) {
+            const int16_t* samples = input + frame * 2;
+            __m128i a = load(samples);
+            __m128i b = load(samples + 8);
+            store(outputs[0] + frame, evenSamples(a, b));
+            store(outputs[1] + frame, oddSamples(a, b));
+        }
+    } else if (numChannels == 4) {
+        for (; frame + 8 <= numFrames; frame += 8) {
+            const int16_t* samples = input + frame * 4;
+            __m128i a = load(samples);
+            __m128i b = load(samples + 8);
+            __m128i c = load(samples + 16);
+            __m128i d = load(samples + 24);
+            // channel 0 and 2, channel 1 and 3, then split again
+            __m128i even1 = evenSamples(a, b);
+            __m128i even2 = evenSamples(c, d);
+            __m128i odd1 = oddSamples(a, b);
+            __m128i odd2 = oddSamples(c, d);
+            store(outputs[0] + frame, evenSamples(even1, even2));
+            store(outputs[1] + frame, evenSamples(odd1, odd2));
+            store(outputs[2] + frame, oddSamples(even1, even2));
+            store(outputs[3] + frame, oddSamples(odd1, odd2));
+        }
+    }
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+    // 8 frames per iteration
+    if (numChannels == 2) {
+        for (; frame + 8 <= numFrames; frame += 8) {
+            int16x8x2_t samples = vld2q_s16(input + frame * 2);
+            vst1q_s16(outputs[0] + frame, samples.val[0]);
+            vst1q_s16(outputs[1] + frame, samples.val[1]);
+        }
+    } else if (numChannels == 3) {
+        for (; frame + 8 <= numFrames; frame += 8) {
+            int16x8x3_t samples = vld3q_s16(input + frame * 3);
+            vst1q_s16(outputs[0] + frame, samples.val[0]);
+            vst1q_s16(outputs[1] + frame, samples.val[1]);
+            vst1q_s16(outputs[2] + frame, samples.val[2]);
+        }
+    } else if (numChannels == 4) {
+        for (; frame + 8 <= numFrames; frame += 8) {
+            int16x8x4_t samples = vld4q_s16(input + frame * 4);
+            vst1q_s16(outputs[0] + frame, samples.val[0]);
+            vst1q_s16(outputs[1] + frame, samples.val[1]);
+            vst1q_s16(outputs[2] + frame, samples.val[2]);
+            vst1q_s16(outputs[3] + frame, samples.val[3]);
+        }
+    }
+#endif
+    for (; frame < numFrames; ++frame) {
+        for (size_t channel = 0; channel < numChannels; ++channel) {
+            outputs[channel][frame] = input[frame * numChannels + channel];
+        }
+    }
+}
+
+}  // namespace Audio
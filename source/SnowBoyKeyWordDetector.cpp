@@ -1,16 +1,21 @@
 #include "SnowBoyKeyWordDetector.h"
+#include <algorithm>
+#include <cmath>
 #include <sstream>
 #include "BaseException.h"
 
-#include <unistd.h>
-
 using BaseClass::BaseException;
 
 namespace KeyWord {
 /// SnowBoy returns -1 if an error occurred.
 static constexpr int SNOWBOY_ERROR_DETECTION_RESULT = -1;
 
-static const int MICROSECONDS_BETWEEN_SAMPLES = 100000;
+/// SnowBoy VAD returns -2 for silence, errors count as speech so the hot word
+/// model isn't stopped by them
+static constexpr int SNOWBOY_VAD_SILENCE_RESULT = -2;
+
+/// Wake up at least this often to check if the detector is still running
+static const std::chrono::milliseconds READ_TIMEOUT{100};
 
 static const std::string TAG = "SnowBoyKeyWordDetector";
 
@@ -19,9 +24,64 @@ SnowBoyKeyWordDetector::SnowBoyKeyWordDetector(
     const std::vector<SnowBoyModelConfig> configs,
     const std::string& resourceFile,
     const float audioGain,
-    const bool applyFrontEnd)
-    : m_reader{reader}, m_isRunning{false} {
-    if (m_reader == nullptr) {
+    const bool applyFrontEnd,
+    const std::chrono::milliseconds frameDuration,
+    const SnowBoyVadConfig& vadConfig)
+    : SnowBoyKeyWordDetector(reader,
+                             nullptr,
+                             configs,
+                             resourceFile,
+                             audioGain,
+                             applyFrontEnd,
+                             frameDuration,
+                             vadConfig) {}
+
+SnowBoyKeyWordDetector::SnowBoyKeyWordDetector(
+    std::shared_ptr<Audio::AudioInputFloatStream::Reader> reader,
+    const std::vector<SnowBoyModelConfig> configs,
+    const std::string& resourceFile,
+    const float audioGain,
+    const bool applyFrontEnd,
+    const std::chrono::milliseconds frameDuration,
+    const SnowBoyVadConfig& vadConfig)
+    : SnowBoyKeyWordDetector(nullptr,
+                             reader,
+                             configs,
+                             resourceFile,
+                             audioGain,
+                             applyFrontEnd,
+                             frameDuration,
+                             vadConfig) {}
+
+SnowBoyKeyWordDetector::SnowBoyKeyWordDetector(
+    std::shared_ptr<Audio::AudioInputStream::Reader> reader,
+    std::shared_ptr<Audio::AudioInputFloatStream::Reader> floatReader,
+    const std::vector<SnowBoyModelConfig>& configs,
+    const std::string& resourceFile,
+    const float audioGain,
+    const bool applyFrontEnd,
+    const std::chrono::milliseconds frameDuration,
+    const SnowBoyVadConfig& vadConfig)
+    : m_reader{reader},
+      m_floatReader{floatReader},
+      m_numDetections{0},
+      m_totalLatencyUs{0},
+      m_maxLatencyUs{0},
+      m_preRollSize{0},
+      m_hangoverSize{0},
+      m_voiceActivityState{
+          KeyWordObserverInterface::VoiceActivityState::SILENCE},
+      m_vadPosition{0},
+      m_lastSpeechPosition{0},
+      m_hotWordPosition{0},
+      m_processedPosition{0},
+      m_numFrames{0},
+      m_numHotWordFrames{0},
+      m_vadTimeNs{0},
+      m_hotWordTimeNs{0},
+      m_numProcessedSamples{0},
+      m_isRunning{false} {
+    if (m_reader == nullptr && m_floatReader == nullptr) {
         std::string errorMsg = "Received a null reader. ";
         BasicLogger::getInstance().log(TAG, LogLevel::ERROR, errorMsg);
 
@@ -48,6 +108,36 @@ SnowBoyKeyWordDetector::SnowBoyKeyWordDetector(
     m_snowBoyEngine->SetAudioGain(audioGain);
     m_snowBoyEngine->ApplyFrontend(applyFrontEnd);
 
+    m_frameSize = m_snowBoyEngine->SampleRate() * frameDuration.count() / 1000;
+    if (m_frameSize == 0) {
+        std::string errorMsg = "Invalid frame duration";
+        BasicLogger::getInstance().log(TAG, LogLevel::ERROR, errorMsg);
+
+        throw BaseException(errorMsg);
+    }
+    if (m_floatReader != nullptr) {
+        m_floatFrameBuffer.resize(m_frameSize);
+    } else {
+        m_frameBuffer.resize(m_frameSize);
+    }
+    for (SnowBoyModelConfig c : configs) {
+        m_keyWordCompensations.push_back(m_snowBoyEngine->SampleRate() *
+                                         c.latencyCompensation.count() / 1000);
+    }
+
+    if (!vadConfig.resourceFile.empty()) {
+        m_vad = std::make_unique<SnowBoyVadWrapper>(
+            vadConfig.resourceFile.c_str());
+        m_vad->SetAudioGain(audioGain);
+        m_vad->ApplyFrontend(applyFrontEnd);
+        m_preRollSize = m_vad->SampleRate() * vadConfig.preRoll.count() / 1000;
+        m_hangoverSize =
+            m_vad->SampleRate() * vadConfig.hangover.count() / 1000;
+        if (m_floatReader != nullptr) {
+            m_vadBuffer.resize(m_frameSize);
+        }
+    }
+
     m_isRunning = true;
     m_detectionThread = std::make_unique<std::thread>(
         &SnowBoyKeyWordDetector::detectionThreadLoop, this);
@@ -58,6 +148,58 @@ SnowBoyKeyWordDetector::~SnowBoyKeyWordDetector() {
                                    "*** THREAD JOINING ***");
     m_isRunning = false;
     m_detectionThread->join();
+    if (m_vad != nullptr) {
+        BasicLogger::getInstance().log(
+            TAG, LogLevel::INFO,
+            "hot word model ran on " + std::to_string(getNumHotWordFrames()) +
+                " of " + std::to_string(getNumFrames()) +
+                " frames | VAD saved " +
+                std::to_string(getSavedCpuTime().count()) + " us CPU time");
+    }
+}
+
+std::chrono::microseconds SnowBoyKeyWordDetector::getAverageDetectionLatency()
+    const {
+    uint64_t numDetections = getNumDetections();
+    return std::chrono::microseconds(
+        numDetections > 0
+            ? m_totalLatencyUs.load(std::memory_order_relaxed) / numDetections
+            : 0);
+}
+
+std::chrono::microseconds SnowBoyKeyWordDetector::getMaxDetectionLatency()
+    const {
+    return std::chrono::microseconds(
+        m_maxLatencyUs.load(std::memory_order_relaxed));
+}
+
+uint64_t SnowBoyKeyWordDetector::getNumDetections() const {
+    return m_numDetections.load(std::memory_order_relaxed);
+}
+
+uint64_t SnowBoyKeyWordDetector::getNumFrames() const {
+    return m_numFrames.load(std::memory_order_relaxed);
+}
+
+uint64_t SnowBoyKeyWordDetector::getNumHotWordFrames() const {
+    return m_numHotWordFrames.load(std::memory_order_relaxed);
+}
+
+uint64_t SnowBoyKeyWordDetector::getNumProcessedSamples() const {
+    return m_numProcessedSamples.load(std::memory_order_relaxed);
+}
+
+std::chrono::microseconds SnowBoyKeyWordDetector::getSavedCpuTime() const {
+    uint64_t numHotWordFrames = getNumHotWordFrames();
+    if (numHotWordFrames == 0) {
+        return std::chrono::microseconds(0);
+    }
+    double hotWordTimeNs = m_hotWordTimeNs.load(std::memory_order_relaxed);
+    double skippedNum = static_cast<double>(getNumFrames()) -
+                        static_cast<double>(numHotWordFrames);
+    double savedNs = skippedNum * hotWordTimeNs / numHotWordFrames -
+                     m_vadTimeNs.load(std::memory_order_relaxed);
+    return std::chrono::microseconds(static_cast<int64_t>(savedNs / 1000));
 }
 
 void SnowBoyKeyWordDetector::detectionThreadLoop() {
@@ -65,35 +207,220 @@ void SnowBoyKeyWordDetector::detectionThreadLoop() {
                                    "*** THREAD START ***");
     notifykeyWordObservers(
         KeyWordObserverInterface::KeyWordDetectorState::ACTIVE);
-    std::vector<Audio::AudioInputStreamSize> audioData;
+    if (m_vad != nullptr) {
+        notifykeyWordObservers(m_voiceActivityState);
+    }
+    if (m_floatReader != nullptr) {
+        detectionLoop(*m_floatReader, m_floatFrameBuffer);
+    } else {
+        detectionLoop(*m_reader, m_frameBuffer);
+    }
+    BasicLogger::getInstance().log(TAG, LogLevel::DEBUG, "*** THREAD END ***");
+    notifykeyWordObservers(
+        KeyWordObserverInterface::KeyWordDetectorState::STOP);
+}
+
+template <typename Reader, typename T>
+void SnowBoyKeyWordDetector::detectionLoop(Reader& reader,
+                                           std::vector<T>& frameBuffer) {
+    const std::chrono::nanoseconds samplePeriod =
+        std::chrono::seconds(1) / m_snowBoyEngine->SampleRate();
     while (m_isRunning) {
-        audioData.resize(m_reader->getAvailableNum());
-        size_t nRead = m_reader->read(audioData.data(), audioData.size());
-        int detectRet = 0;
-        if (0 == nRead) {
-            BasicLogger::getInstance().log(TAG, LogLevel::WARNING,
-                                           "reader read nothing from stream");
-        } else {
-            detectRet = m_snowBoyEngine->RunDetection(audioData.data(), nRead);
+        // less than a frame is only returned when the writer is closed, the
+        // tail is still detected
+        size_t availableNum = reader.wait(m_frameSize, READ_TIMEOUT);
+        if (availableNum == 0) {
+            if (reader.isWriterClosed()) {
+                // end of stream, nothing comes until the writer opens again
+                std::this_thread::sleep_for(READ_TIMEOUT);
+            }
+            continue;
+        }
+        auto wakeTime = std::chrono::steady_clock::now();
+        bool isTail = availableNum < m_frameSize;
+        // catch up with whole frames already there, one frame at a time
+        while ((availableNum >= m_frameSize || (isTail && availableNum > 0)) &&
+               m_isRunning) {
+            size_t frameSize;
+            uint64_t position;
+            const T* frame =
+                peekFrame(reader, frameBuffer,
+                          std::min(m_frameSize, availableNum), frameSize,
+                          position);
+            if (frameSize == 0) {
+                break;
+            }
+            availableNum -= std::min(availableNum, frameSize);
+
+            bool shouldDetect = true;
+            if (m_vad != nullptr) {
+                if (updateVoiceActivity(frame, frameSize, position)) {
+                    // hot word model starts from pre-roll, this frame
+                    // included
+                    rewindToPreRoll(reader, position);
+                    availableNum = reader.getAvailableNum();
+                    continue;
+                }
+                shouldDetect =
+                    m_voiceActivityState ==
+                    KeyWordObserverInterface::VoiceActivityState::SPEECH;
+            } else {
+                m_numFrames.fetch_add(1, std::memory_order_relaxed);
+            }
+
+            int detectRet = 0;
+            if (shouldDetect) {
+                auto startTime = std::chrono::steady_clock::now();
+                detectRet = m_snowBoyEngine->RunDetection(frame, frameSize);
+                m_hotWordTimeNs.fetch_add(
+                    std::chrono::duration_cast<std::chrono::nanoseconds>(
+                        std::chrono::steady_clock::now() - startTime)
+                        .count(),
+                    std::memory_order_relaxed);
+                m_numHotWordFrames.fetch_add(1, std::memory_order_relaxed);
+                m_hotWordPosition = position + frameSize;
+            }
+            // end of the frame snowboy fired in, peeked after any overrun
+            // audio was skipped
+            uint64_t frameEnd = position + frameSize;
+            // counted before consume, so whoever sees the stream drained
+            // sees the count too
+            if (frameEnd > m_processedPosition) {
+                m_numProcessedSamples.fetch_add(
+                    frameEnd - std::max(position, m_processedPosition),
+                    std::memory_order_relaxed);
+                m_processedPosition = frameEnd;
+            }
+            if (!reader.consume(frameSize)) {
+                BasicLogger::getInstance().log(
+                    TAG, LogLevel::WARNING,
+                    "audio was overwritten while running detection");
+            }
+
             if (detectRet > 0 && (detectRet <= m_keyWords.size())) {
-                // detected sth.
+                // detected sth. the newest sample arrived at wake up, the
+                // last sample of this frame arrived before the ones left
+                auto latency = std::chrono::steady_clock::now() - wakeTime +
+                               samplePeriod * availableNum;
+                recordLatency(latency);
                 BasicLogger::getInstance().log(
                     TAG, LogLevel::DEBUG,
                     std::string("KeyWord detected:") +
-                        m_keyWords[detectRet - 1]);
-                notifykeyWordObservers(m_keyWords[detectRet - 1],
-                                       m_reader->getIndex());
+                        m_keyWords[detectRet - 1] + " | latency " +
+                        std::to_string(std::chrono::duration_cast<
+                                           std::chrono::microseconds>(latency)
+                                           .count()) +
+                        " us");
+                uint64_t compensation = m_keyWordCompensations[detectRet - 1];
+                notifykeyWordObservers(
+                    m_keyWords[detectRet - 1],
+                    frameEnd - std::min(frameEnd, compensation));
             } else if (detectRet == SNOWBOY_ERROR_DETECTION_RESULT /*-1*/) {
                 // error
                 notifykeyWordObservers(
                     KeyWordObserverInterface::KeyWordDetectorState::ERROR);
             }
         }
-        usleep(MICROSECONDS_BETWEEN_SAMPLES);
     }
-    BasicLogger::getInstance().log(TAG, LogLevel::DEBUG, "*** THREAD END ***");
-    notifykeyWordObservers(
-        KeyWordObserverInterface::KeyWordDetectorState::STOP);
+}
+
+template <typename Reader, typename T>
+const T* SnowBoyKeyWordDetector::peekFrame(Reader& reader,
+                                           std::vector<T>& frameBuffer,
+                                           size_t frameSize,
+                                           size_t& peekedNum,
+                                           uint64_t& position) {
+    // feed snowboy straight from the stream storage. A mirrored stream is
+    // never split by the wrap point, copy only for plain heap storage
+    auto regions = reader.peek(frameSize);
+    peekedNum = regions.size();
+    position = regions.position;
+    if (regions.size2 == 0) {
+        return regions.data1;
+    }
+    std::copy(regions.data1, regions.data1 + regions.size1,
+              frameBuffer.begin());
+    std::copy(regions.data2, regions.data2 + regions.size2,
+              frameBuffer.begin() + regions.size1);
+    return frameBuffer.data();
+}
+
+bool SnowBoyKeyWordDetector::updateVoiceActivity(const float* frame,
+                                                 size_t frameSize,
+                                                 uint64_t position) {
+    // samples are in 16 bits range already, only round and saturate
+    for (size_t i = 0; i < frameSize; ++i) {
+        m_vadBuffer[i] = static_cast<int16_t>(std::lrint(
+            std::min(std::max(frame[i], -32768.0f), 32767.0f)));
+    }
+    return updateVoiceActivity(m_vadBuffer.data(), frameSize, position);
+}
+
+bool SnowBoyKeyWordDetector::updateVoiceActivity(const int16_t* frame,
+                                                 size_t frameSize,
+                                                 uint64_t position) {
+    uint64_t frameEnd = position + frameSize;
+    if (frameEnd <= m_vadPosition) {
+        // pre-roll which is replayed to the hot word model, counted like the
+        // hot word frame it becomes so skipped frames stay right
+        m_numFrames.fetch_add(1, std::memory_order_relaxed);
+        return false;
+    }
+    size_t seenNum = m_vadPosition > position ? m_vadPosition - position : 0;
+    auto startTime = std::chrono::steady_clock::now();
+    int vadRet = m_vad->RunVad(frame + seenNum, frameSize - seenNum);
+    m_vadTimeNs.fetch_add(
+        std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now() - startTime)
+            .count(),
+        std::memory_order_relaxed);
+    m_numFrames.fetch_add(1, std::memory_order_relaxed);
+    m_vadPosition = frameEnd;
+
+    using VoiceActivityState = KeyWordObserverInterface::VoiceActivityState;
+    if (vadRet != SNOWBOY_VAD_SILENCE_RESULT) {
+        m_lastSpeechPosition = frameEnd;
+        if (m_voiceActivityState == VoiceActivityState::SILENCE) {
+            m_voiceActivityState = VoiceActivityState::SPEECH;
+            BasicLogger::getInstance().log(TAG, LogLevel::DEBUG,
+                                           "speech starts");
+            notifykeyWordObservers(m_voiceActivityState);
+            return true;
+        }
+    } else if (m_voiceActivityState == VoiceActivityState::SPEECH &&
+               frameEnd - m_lastSpeechPosition >= m_hangoverSize) {
+        m_voiceActivityState = VoiceActivityState::SILENCE;
+        BasicLogger::getInstance().log(TAG, LogLevel::DEBUG, "speech ends");
+        notifykeyWordObservers(m_voiceActivityState);
+    }
+    return false;
+}
+
+template <typename Reader>
+void SnowBoyKeyWordDetector::rewindToPreRoll(Reader& reader,
+                                             uint64_t position) {
+    uint64_t preRollPosition =
+        position - std::min<uint64_t>(position, m_preRollSize);
+    // never feed the hot word model the same audio twice
+    preRollPosition = std::max(preRollPosition, m_hotWordPosition);
+    if (preRollPosition != m_hotWordPosition) {
+        // there is a gap since the hot word model stopped
+        m_snowBoyEngine->Reset();
+    }
+    reader.setPosition(preRollPosition);
+}
+
+void SnowBoyKeyWordDetector::recordLatency(
+    std::chrono::steady_clock::duration latency) {
+    uint64_t latencyUs =
+        std::chrono::duration_cast<std::chrono::microseconds>(latency).count();
+    m_totalLatencyUs.fetch_add(latencyUs, std::memory_order_relaxed);
+    uint64_t maxLatencyUs = m_maxLatencyUs.load(std::memory_order_relaxed);
+    while (latencyUs > maxLatencyUs &&
+           !m_maxLatencyUs.compare_exchange_weak(maxLatencyUs, latencyUs,
+                                                 std::memory_order_relaxed)) {
+    }
+    m_numDetections.fetch_add(1, std::memory_order_relaxed);
 }
 
 }  // namespace KeyWord
\ No newline at end of file
@@ -32,4 +32,29 @@ int SnowBoyWrapper::RunDetection(const int16_t* data, int num_samples) {
     return m_detector->RunDetection(data, num_samples);
 }
 
+int SnowBoyWrapper::RunDetection(const float* data, int num_samples) {
+    return m_detector->RunDetection(data, num_samples);
+}
+
+void SnowBoyWrapper::Reset() { m_detector->Reset(); }
+
+SnowBoyVadWrapper::SnowBoyVadWrapper(const char* resource_name) {
+    m_vad = std::make_unique<snowboy::SnowboyVad>(resource_name);
+}
+SnowBoyVadWrapper::~SnowBoyVadWrapper() {}
+int SnowBoyVadWrapper::SampleRate() const { return m_vad->SampleRate(); }
+
+void SnowBoyVadWrapper::SetAudioGain(const float audio_gain) {
+    m_vad->SetAudioGain(audio_gain);
+}
+void SnowBoyVadWrapper::ApplyFrontend(const bool apply_frontend) {
+    m_vad->ApplyFrontend(apply_frontend);
+}
+
+int SnowBoyVadWrapper::RunVad(const int16_t* data, int num_samples) {
+    return m_vad->RunVad(data, num_samples);
+}
+
+void SnowBoyVadWrapper::Reset() { m_vad->Reset(); }
+
 }  // namespace KeyWord
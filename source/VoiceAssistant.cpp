@@ -2,7 +2,14 @@
 
 namespace VoiceAssistantService {
 
-VoiceAssistant::VoiceAssistant(){}
+VoiceAssistant::VoiceAssistant()
+    : m_eventDispatcher{std::make_unique<Utils::Threading::EventDispatcher>(
+          "VoiceAssistant")} {}
+
+const Utils::Threading::EventDispatcher& VoiceAssistant::getEventDispatcher()
+    const {
+    return *m_eventDispatcher;
+}
 
 void VoiceAssistant::addVoiceAssistantObserver(
     std::shared_ptr<VoiceAssistantObserverInterface> VoiceAssistantObserver) {
@@ -17,10 +24,12 @@ void VoiceAssistant::removeVoiceAssistantObserver(
 
 void VoiceAssistant::notifyVoiceAssistantObservers(
     VoiceAssistantObserverInterface::VoiceAssistantState state) const {
-    std::lock_guard<std::mutex> lock(m_VoiceAssistantObserversMtx);
-    for (auto VoiceAssistantObserver : m_VoiceAssistantObservers) {
-        VoiceAssistantObserver->onStateChanged(state);
-    }
+    m_eventDispatcher->dispatch([this, state]() {
+        std::lock_guard<std::mutex> lock(m_VoiceAssistantObserversMtx);
+        for (auto VoiceAssistantObserver : m_VoiceAssistantObservers) {
+            VoiceAssistantObserver->onStateChanged(state);
+        }
+    });
 }
 
 
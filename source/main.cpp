@@ -1,29 +1,179 @@
 #include <unistd.h>
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
 #include <memory>
 #include <thread>
 
+#include "AlsaMmapBackend.h"
 #include "AudioStream.h"
 #include "BasicLogger.h"
+#include "FileAudioBackend.h"
 #include "GoogleVoiceAssistant.h"
+#include "ParallelSnowBoyKeyWordDetector.h"
 #include "Player.h"
+#include "PortAudioWrapper.h"
 #include "Recorder.h"
+#include "ResamplerStage.h"
 #include "SnowBoyKeyWordDetector.h"
 
 using namespace Utils::Logger;
 
-int main(int argc, char const* argv[]) {
-    auto inputStream = std::make_unique<Audio::AudioInputStream>(16384);
-    auto ouputStream = std::make_unique<Audio::AudioOutputStream>(163840);
+static const std::string TAG = "main";
 
-    auto portAudioWrapper =
-        std::make_shared<Audio::PortAudio::PortAudioWrapper>();
+/// Rate of snowboy and assistant audio, devices may run at another one
+static const int ASSISTANT_SAMPLE_RATE = 16000;
 
-    auto snowBoyReader = inputStream->createReader();
+using CaptureResampler =
+    Audio::ResamplerStage<Audio::AudioInputStream, Audio::AudioInputStream>;
+using PlaybackResampler =
+    Audio::ResamplerStage<Audio::AudioOutputStream, Audio::AudioOutputStream>;
 
-    auto recorder = std::make_unique<Audio::Recorder::Recorder>(
-        16000, 16, 1, inputStream->createWriter(), portAudioWrapper);
+int main(int argc, char* argv[]) {
+    // -i corpus.wav [-o response.wav] [-s 50] runs from a recorded corpus
+    // instead of sound card, at 50 times real time. -r 48000 runs devices at
+    // 48 kHz and resamples between them and the assistant. -v only runs hot
+    // word model while VAD finds speech. -p 4 shards models into 4 threads.
+    // -d captures and plays on one PortAudio stream, on the same clock. -b alsa
+    // drives ALSA default devices through mmap instead of PortAudio. -f feeds
+    // snowboy float samples from a stream of its own
+    std::string inputFile;
+    std::string outputFile;
+    float speed = 1.0f;
+    int deviceSampleRate = ASSISTANT_SAMPLE_RATE;
+    bool shouldGateByVad = false;
+    int numDetectorShards = 1;
+    bool isDuplex = false;
+    std::string backendName = "portaudio";
+    bool isFloatDetection = false;
+    int opt;
+    while ((opt = getopt(argc, argv, "i:o:s:r:vp:db:f")) != -1) {
+        switch (opt) {
+            case 'f':
+                isFloatDetection = true;
+                break;
+            case 'b':
+                backendName = optarg;
+                break;
+            case 'd':
+                isDuplex = true;
+                break;
+            case 'p':
+                numDetectorShards = std::atoi(optarg);
+                break;
+            case 'v':
+                shouldGateByVad = true;
+                break;
+            case 'r':
+                deviceSampleRate = std::atoi(optarg);
+                break;
+            case 'i':
+                inputFile = optarg;
+                break;
+            case 'o':
+                outputFile = optarg;
+                break;
+            case 's':
+                speed = std::strtof(optarg, nullptr);
+                break;
+            default:
+                return 1;
+        }
+    }
 
-    recorder->startRecord();
+    // a corpus run measures the detector, files wait for it instead of
+    // overrunning it
+    auto inputOverflowPolicy =
+        inputFile.empty() ? Utils::DataStructures::OverflowPolicy::DROP_OLDEST
+                          : Utils::DataStructures::OverflowPolicy::BLOCK_WRITER;
+    // snowboy and assistant peek straight from mirrored storage, no frame is
+    // ever split by the wrap point
+    auto inputStream = std::make_unique<Audio::AudioInputStream>(
+        Audio::AudioInputStreamCapacity,
+        Utils::DataStructures::CircularBufferStorage::MIRRORED,
+        inputOverflowPolicy);
+    // long responses mustn't be truncated, let GVA wait for the player
+    auto ouputStream = std::make_unique<Audio::AudioOutputStream>(
+        163840, Utils::DataStructures::CircularBufferStorage::HEAP,
+        Utils::DataStructures::OverflowPolicy::BLOCK_WRITER);
+
+    // the assistant still reads int16_t from the input stream
+    std::unique_ptr<Audio::AudioInputFloatStream> detectorStream;
+    if (isFloatDetection) {
+        if (deviceSampleRate != ASSISTANT_SAMPLE_RATE ||
+            numDetectorShards > 1) {
+            BasicLogger::getInstance().log(
+                TAG, LogLevel::ERROR,
+                "Float detection needs devices at 16 kHz and one detector");
+            return 1;
+        }
+        detectorStream = std::make_unique<Audio::AudioInputFloatStream>(
+            Audio::AudioInputStreamCapacity,
+            Utils::DataStructures::CircularBufferStorage::HEAP,
+            inputOverflowPolicy);
+    }
+
+    std::shared_ptr<Audio::AudioBackend> audioBackend;
+    std::shared_ptr<Audio::File::FileAudioBackend> fileAudioBackend;
+    if (backendName != "portaudio" && backendName != "alsa") {
+        BasicLogger::getInstance().log(TAG, LogLevel::ERROR,
+                                       "Unknown backend " + backendName);
+        return 1;
+    }
+    if (isDuplex && backendName != "portaudio") {
+        BasicLogger::getInstance().log(
+            TAG, LogLevel::ERROR, "Full duplex needs the portaudio backend");
+        return 1;
+    }
+    if (!inputFile.empty()) {
+        fileAudioBackend = std::make_shared<Audio::File::FileAudioBackend>(
+            inputFile, outputFile, speed);
+        audioBackend = fileAudioBackend;
+    } else if (backendName == "alsa") {
+        audioBackend = std::make_shared<Audio::Alsa::AlsaMmapBackend>();
+    } else {
+        audioBackend =
+            std::make_shared<Audio::PortAudio::PortAudioWrapper>(isDuplex);
+    }
+
+    // devices use their own streams if they don't run at assistant rate
+    std::unique_ptr<Audio::AudioInputStream> captureStream;
+    std::unique_ptr<CaptureResampler> captureResampler;
+    std::unique_ptr<Audio::AudioOutputStream> playbackStream;
+    std::unique_ptr<PlaybackResampler> playbackResampler;
+    std::unique_ptr<Audio::AudioInputStream::Writer> recorderWriter;
+    std::shared_ptr<Audio::AudioOutputStream::Reader> playerReader;
+    if (deviceSampleRate == ASSISTANT_SAMPLE_RATE) {
+        recorderWriter = inputStream->createWriter();
+        playerReader = ouputStream->createReader();
+    } else {
+        captureStream = std::make_unique<Audio::AudioInputStream>(
+            Audio::AudioInputStreamCapacity,
+            Utils::DataStructures::CircularBufferStorage::HEAP,
+            inputOverflowPolicy);
+        recorderWriter = captureStream->createWriter();
+        captureResampler = std::make_unique<CaptureResampler>(
+            captureStream->createReader(), inputStream->createWriter(),
+            deviceSampleRate, ASSISTANT_SAMPLE_RATE);
+
+        playbackStream = std::make_unique<Audio::AudioOutputStream>(
+            163840, Utils::DataStructures::CircularBufferStorage::HEAP,
+            Utils::DataStructures::OverflowPolicy::BLOCK_WRITER);
+        playerReader = playbackStream->createReader();
+        playbackResampler = std::make_unique<PlaybackResampler>(
+            ouputStream->createReader(), playbackStream->createWriter(),
+            ASSISTANT_SAMPLE_RATE, deviceSampleRate);
+    }
+
+    std::unique_ptr<Audio::Recorder::Recorder> recorder;
+    if (detectorStream) {
+        recorder = std::make_unique<Audio::Recorder::Recorder>(
+            deviceSampleRate, 16, 1, std::move(recorderWriter),
+            detectorStream->createWriter(), audioBackend);
+    } else {
+        recorder = std::make_unique<Audio::Recorder::Recorder>(
+            deviceSampleRate, 16, 1, std::move(recorderWriter), audioBackend);
+    }
 
     std::vector<KeyWord::SnowBoyKeyWordDetector::SnowBoyModelConfig> config;
     KeyWord::SnowBoyKeyWordDetector::SnowBoyModelConfig tConfig;
@@ -40,8 +190,52 @@ int main(int argc, char const* argv[]) {
     // tConfig.sensitivity = "0.5";
     // config.push_back(tConfig);
 
-    auto snowBoy = std::make_unique<KeyWord::SnowBoyKeyWordDetector>(
-        snowBoyReader, config, "../resources/common.res", 1.0, true);
+    // a shard without model would only burn CPU, and the assistant needs one
+    // more reader of the input stream
+    int maxDetectorShards = static_cast<int>(std::min(
+        config.size(), Audio::AudioInputStream::MAX_READERS - 1));
+    if (numDetectorShards > maxDetectorShards) {
+        BasicLogger::getInstance().log(
+            TAG, LogLevel::WARNING,
+            "Only " + std::to_string(maxDetectorShards) + " detector shards");
+        numDetectorShards = maxDetectorShards;
+    }
+
+    KeyWord::SnowBoyVadConfig vadConfig;
+    if (shouldGateByVad) {
+        vadConfig.resourceFile = "../resources/common.res";
+    }
+    std::unique_ptr<KeyWord::SnowBoyKeyWordDetector> snowBoy;
+    std::unique_ptr<KeyWord::ParallelSnowBoyKeyWordDetector> parallelSnowBoy;
+    KeyWord::KeyWordDetector* keyWordDetector;
+    // kept to find out when the detector has drained a corpus
+    std::vector<std::shared_ptr<Audio::AudioInputStream::Reader>>
+        detectorReaders;
+    std::shared_ptr<Audio::AudioInputFloatStream::Reader> floatDetectorReader;
+    if (detectorStream) {
+        floatDetectorReader = detectorStream->createReader();
+    } else {
+        for (int i = 0; i < std::max(numDetectorShards, 1); ++i) {
+            detectorReaders.push_back(inputStream->createReader());
+        }
+    }
+    if (floatDetectorReader) {
+        snowBoy = std::make_unique<KeyWord::SnowBoyKeyWordDetector>(
+            floatDetectorReader, config, "../resources/common.res", 1.0, true,
+            std::chrono::milliseconds(10), vadConfig);
+        keyWordDetector = snowBoy.get();
+    } else if (numDetectorShards > 1) {
+        parallelSnowBoy =
+            std::make_unique<KeyWord::ParallelSnowBoyKeyWordDetector>(
+                detectorReaders, config, "../resources/common.res", 1.0, true,
+                std::chrono::milliseconds(10), vadConfig);
+        keyWordDetector = parallelSnowBoy.get();
+    } else {
+        snowBoy = std::make_unique<KeyWord::SnowBoyKeyWordDetector>(
+            detectorReaders.front(), config, "../resources/common.res", 1.0,
+            true, std::chrono::milliseconds(10), vadConfig);
+        keyWordDetector = snowBoy.get();
+    }
 
     VoiceAssistantService::GoogleVoiceAssistant::GoogleVoiceAssistantConfig
         gvaConfig;
@@ -50,21 +244,98 @@ int main(int argc, char const* argv[]) {
     gvaConfig.language_code = "en-US";
     gvaConfig.device_id = "default";
     gvaConfig.device_model_id = "default";
-    gvaConfig.output_sample_rate_hertz = 16000;
+    gvaConfig.output_sample_rate_hertz = ASSISTANT_SAMPLE_RATE;
     gvaConfig.output_encoding =
         AudioOutConfig_Encoding::AudioOutConfig_Encoding_LINEAR16;
-    gvaConfig.input_sample_rate_hertz = 16000;
+    gvaConfig.input_sample_rate_hertz = ASSISTANT_SAMPLE_RATE;
     gvaConfig.input_encoding =
         AudioInConfig_Encoding::AudioInConfig_Encoding_LINEAR16;
 
     auto gvaPlayer = std::make_unique<Audio::Player::Player>(
-        16000, 16, 1, ouputStream->createReader(), portAudioWrapper);
+        deviceSampleRate, 16, 1, playerReader, audioBackend);
 
+    // the assistant only reads after a keyword, it mustn't hold back a
+    // corpus while it is idle
+    auto gvaReader = inputStream->createReader();
+    gvaReader->setBlockingWriter(false);
     auto gva = std::make_shared<VoiceAssistantService::GoogleVoiceAssistant>(
-        std::move(gvaConfig), ouputStream->createWriter(),
-        inputStream->createReader(), std::move(gvaPlayer));
+        std::move(gvaConfig), ouputStream->createWriter(), gvaReader,
+        std::move(gvaPlayer));
+
+    keyWordDetector->addKeyWordObserver(gva);
 
-    snowBoy->addKeyWordObserver(gva);
+    // start capturing once the whole pipeline is ready
+    auto startTime = std::chrono::steady_clock::now();
+    recorder->startRecord();
+
+    if (fileAudioBackend) {
+        while (!fileAudioBackend->waitForInputEnd(std::chrono::seconds(1))) {
+        }
+        // closing the writers ends the stream, the detector drains the rest
+        recorder->stopRecord();
+        for (auto& reader : detectorReaders) {
+            while (!reader->isWriterClosed() || reader->getAvailableNum() > 0) {
+                std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            }
+        }
+        if (floatDetectorReader) {
+            while (!floatDetectorReader->isWriterClosed() ||
+                   floatDetectorReader->getAvailableNum() > 0) {
+                std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            }
+        }
+        std::chrono::duration<double> elapsed =
+            std::chrono::steady_clock::now() - startTime;
+        uint64_t numProcessedSamples =
+            snowBoy ? snowBoy->getNumProcessedSamples()
+                    : parallelSnowBoy->getNumProcessedSamples();
+        double audioSeconds =
+            numProcessedSamples / static_cast<double>(ASSISTANT_SAMPLE_RATE);
+        BasicLogger::getInstance().log(
+            TAG, LogLevel::INFO,
+            "Detector processed " + std::to_string(audioSeconds) +
+                " s of audio in " + std::to_string(elapsed.count()) + " s, " +
+                std::to_string(audioSeconds / elapsed.count()) +
+                " times real time | " +
+                std::to_string(fileAudioBackend->getNumInputFrames()) +
+                " frames read from file | " +
+                std::to_string(detectorStream
+                                   ? detectorStream->getOverrunCount()
+                                   : inputStream->getOverrunCount()) +
+                " stream overruns | " +
+                std::to_string(recorder->getNumDroppedSamples()) +
+                " samples dropped by recorder");
+        const auto& keyWordDispatcher = keyWordDetector->getEventDispatcher();
+        BasicLogger::getInstance().log(
+            TAG, LogLevel::INFO,
+            "keyword notification latency | average " +
+                std::to_string(keyWordDispatcher.getAverageLatency().count()) +
+                " us | max " +
+                std::to_string(keyWordDispatcher.getMaxLatency().count()) +
+                " us");
+        if (snowBoy) {
+            BasicLogger::getInstance().log(
+                TAG, LogLevel::INFO,
+                std::to_string(snowBoy->getNumDetections()) +
+                    " detections | average latency " +
+                    std::to_string(
+                        snowBoy->getAverageDetectionLatency().count()) +
+                    " us | max latency " +
+                    std::to_string(snowBoy->getMaxDetectionLatency().count()) +
+                    " us");
+        } else {
+            BasicLogger::getInstance().log(
+                TAG, LogLevel::INFO,
+                std::to_string(parallelSnowBoy->getNumDetections()) +
+                    " detections in " +
+                    std::to_string(parallelSnowBoy->getNumShards()) +
+                    " shards | max latency " +
+                    std::to_string(
+                        parallelSnowBoy->getMaxDetectionLatency().count()) +
+                    " us");
+        }
+        return 0;
+    }
 
     while (1) {
         usleep(100000);